@@ -0,0 +1,128 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+// Compiles many one-function modules, the way an embedding host or the REPL
+// does, then calls all the functions round after round. Reports how many
+// pages the code is spread over, the resident memory, and the call time,
+// which suffers from iTLB misses when every function sits on its own pages.
+//
+// usage: code_layout_bench [section|pooled|huge] [modules] [rounds]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TargetSelect.h"
+#include "JIT.h"
+#include "LLVMIRGen.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "SourceManager.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+static ExitOnError ExitOnErr;
+
+using LayoutFunction = int64_t(*)(int64_t);
+
+static std::string generateSource(unsigned n) {
+    std::string id = std::to_string(n);
+    return "function integer layout" + id + "(integer x) {\n"
+            "    if (x < " + id + ") {\n"
+            "        return x * 3 + " + id + ";\n"
+            "    }\n"
+            "    return x - " + id + ";\n"
+            "}\n";
+}
+
+static double residentMB() {
+    std::ifstream statm("/proc/self/statm");
+    size_t size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * (double) sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+int main(int argc, char** argv) {
+
+    const char* mode = argc > 1 ? argv[1] : "pooled";
+    unsigned modules = argc > 2 ? atoi(argv[2]) : 5000;
+    unsigned rounds = argc > 3 ? atoi(argv[3]) : 200;
+
+    JITOptions Options;
+    Options.PooledMemory = strcmp(mode, "section") != 0;
+    Options.HugePages = strcmp(mode, "huge") == 0;
+
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+    InitializeNativeTargetAsmParser();
+    auto TheJIT = ExitOnErr(KaleidoscopeJIT::Create(Options));
+    double baseline = residentMB();
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<LayoutFunction> functions;
+    for (unsigned i = 0; i < modules; i++) {
+        std::string name = "layout" + std::to_string(i);
+        unsigned FileID = SourceManager::get().addBuffer(
+                MemoryBuffer::getMemBufferCopy(generateSource(i), name), name);
+        auto context = std::make_unique<LLVMContext>();
+        LLVMIRGen<> generator(context.get());
+        Parser<LLVMValue> parser(std::make_unique<Lexer>(FileID));
+        while (auto exp = parser.nextConstruct()) {
+            generator.GenFromAST(std::move(exp));
+        }
+        std::unique_ptr<Module> module = generator.getModule();
+        module->setDataLayout(TheJIT->getDataLayout());
+        ExitOnErr(TheJIT->addModule(ThreadSafeModule(std::move(module), std::move(context))));
+        auto Symbol = ExitOnErr(TheJIT->lookup(name));
+        functions.push_back((LayoutFunction) (intptr_t) Symbol.getAddress());
+    }
+    double compileMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+
+    std::set<uintptr_t> pages, hugePages;
+    for (auto function : functions) {
+        pages.insert((uintptr_t) function >> 12);
+        hugePages.insert((uintptr_t) function >> 21);
+    }
+
+    // a stride coprime with the count visits the functions out of order
+    unsigned stride = 7919 % modules ? 7919 : 1;
+    int64_t check = 0;
+    start = std::chrono::steady_clock::now();
+    for (unsigned r = 0; r < rounds; r++) {
+        for (unsigned i = 0, idx = 0; i < modules; i++, idx = (idx + stride) % modules) {
+            check += functions[idx](r);
+        }
+    }
+    double callNs = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count() / ((double) rounds * modules);
+
+    printf("%s: %u modules compiled in %.0f ms, code on %zu pages (%zu 2MB regions), "
+            "%.1f MB resident, %.2f ns per call\n", mode, modules, compileMs, pages.size(),
+            hugePages.size(), residentMB() - baseline, callNs);
+    if (SlabPool* Pool = TheJIT->getMemoryPool()) {
+        fflush(stdout);
+        Pool->printStats(outs());
+        outs().flush();
+    }
+    printf("checksum %lld\n", (long long) check);
+    return 0;
+}
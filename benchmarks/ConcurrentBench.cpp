@@ -0,0 +1,103 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+// Calls the same compiled function from an increasing number of threads,
+// each one with its own output sink, and reports the aggregate call rate.
+// The output of every thread is checked once it finishes.
+//
+// usage: concurrent_bench [max threads] [calls per thread in thousands]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "JITCompiler.h"
+
+// the host asks for output once every 64 calls, so the runtime is part of
+// the measure
+static const char* Source =
+        "extern none printinteger(integer v);\n"
+        "function integer step(integer seed, integer n, integer verbose) {\n"
+        "    let integer acc = seed;\n"
+        "    for (let integer i = 0; i < n; i++) {\n"
+        "        acc = acc * 1103515245 + 12345;\n"
+        "    }\n"
+        "    if (verbose == 1) {\n"
+        "        printinteger(seed);\n"
+        "    }\n"
+        "    return acc;\n"
+        "}\n";
+
+static const int64_t Iterations = 50;
+
+int main(int argc, char** argv) {
+
+    unsigned maxThreads = argc > 1 ? atoi(argv[1]) : std::thread::hardware_concurrency();
+    long calls = (argc > 2 ? atol(argv[2]) : 2000) * 1000;
+
+    auto compiler = llvm::cantFail(JITCompiler::Create());
+    std::string error;
+    auto program = compiler->compile(Source, "concurrent", error);
+    auto *step = program ? program->lookup<int64_t(int64_t, int64_t, int64_t)>("step", error) : nullptr;
+    if (!step) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    // the lines each thread must print
+    size_t expected = (calls + 63) / 64;
+    double base = 0;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+
+        std::vector<StringOutputSink> sinks(threads);
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([&, t]() {
+                OutputSinkScope scope(sinks[t]);
+                int64_t sum = 0;
+                for (long i = 0; i < calls; i++) {
+                    sum += step(i, Iterations, (i & 63) == 0);
+                }
+                // keeps the calls alive
+                if (sum == 42) {
+                    printf("!\n");
+                }
+            });
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (auto &sink : sinks) {
+            size_t lines = std::count(sink.output.begin(), sink.output.end(), '\n');
+            if (lines != expected) {
+                fprintf(stderr, "output mixed up: %zu lines, %zu expected\n", lines, expected);
+                return 1;
+            }
+        }
+
+        double rate = threads * calls / seconds / 1e6;
+        if (threads == 1) {
+            base = rate;
+        }
+        printf("%2u threads: %7.2f M calls/s (x%.2f)\n", threads, rate, rate / base);
+    }
+    return 0;
+}
+
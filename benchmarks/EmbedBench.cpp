@@ -0,0 +1,88 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+// Embedding API: compile latency of a small program and calls per second of
+// its functions through the pointers returned by CompiledProgram::lookup.
+//
+// usage: embed_bench [compilations] [calls in millions]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "JITCompiler.h"
+
+static const char* Source =
+        "function integer clamp(integer v, integer lo, integer hi) {\n"
+        "    if (v < lo) {\n"
+        "        return lo;\n"
+        "    }\n"
+        "    if (hi < v) {\n"
+        "        return hi;\n"
+        "    }\n"
+        "    return v;\n"
+        "}\n"
+        "function real lerp(real a, real b, real t) {\n"
+        "    return a + (b - a) * t;\n"
+        "}\n";
+
+static double elapsed(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+
+    int compilations = argc > 1 ? atoi(argv[1]) : 50;
+    long calls = (argc > 2 ? atol(argv[2]) : 100) * 1000000;
+
+    auto compiler = llvm::cantFail(JITCompiler::Create());
+    std::string error;
+
+    std::unique_ptr<CompiledProgram> program;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < compilations; i++) {
+        program = compiler->compile(Source, "bench" + std::to_string(i), error);
+        if (!program) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    printf("compile: %.3f ms per program\n", elapsed(start) * 1000 / compilations);
+
+    auto *clamp = program->lookup<int64_t(int64_t, int64_t, int64_t)>("clamp", error);
+    auto *lerp = program->lookup<double(double, double, double)>("lerp", error);
+    if (!clamp || !lerp) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    // results are accumulated so the calls are not optimized away
+    int64_t isum = 0;
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < calls; i++) {
+        isum += clamp(i & 1023, 100, 900);
+    }
+    double seconds = elapsed(start);
+    printf("clamp: %.1f M calls/s (%lld)\n", calls / seconds / 1e6, (long long) isum);
+
+    double rsum = 0;
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < calls; i++) {
+        rsum += lerp(1.0, 3.0, (i & 1023) / 1024.0);
+    }
+    seconds = elapsed(start);
+    printf("lerp: %.1f M calls/s (%.1f)\n", calls / seconds / 1e6, rsum);
+    return 0;
+}
+
@@ -0,0 +1,123 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+// A script whose hot functions are interleaved with large functions run
+// once, compiled with and without -function-layout: reports how far apart
+// the hot functions are and how long main takes.
+//
+// usage: function_layout_bench [hot functions] [cold functions per hot one] [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <vector>
+#include "JITCompiler.h"
+
+static std::string generateCold(const std::string& name) {
+    std::string source = "function integer " + name + "(integer x) {\n"
+            "    let integer a = x;\n";
+    for (int i = 0; i < 12; i++) {
+        std::string n = std::to_string(i);
+        source += "    a = a * 7 + " + n + ";\n"
+                "    if (a < " + n + "00) {\n"
+                "        a = a * 3 - x;\n"
+                "    } else {\n"
+                "        a = a - " + n + ";\n"
+                "    }\n";
+    }
+    return source + "    return a;\n}\n";
+}
+
+static std::string generateSource(unsigned hot, unsigned cold, unsigned iterations) {
+    std::string source = "extern integer printinteger(integer v);\n";
+    std::string setup, loop;
+    for (unsigned i = 0; i < hot; i++) {
+        std::string n = std::to_string(i);
+        for (unsigned j = 0; j < cold; j++) {
+            std::string name = "setup" + n + "x" + std::to_string(j);
+            source += generateCold(name);
+            setup += "    acc = acc + " + name + "(1);\n";
+        }
+        source += "noinline function integer hot" + n + "(integer x) {\n"
+                "    let integer a = x;\n"
+                "    for (let integer k = 0; k < 4; k++) {\n"
+                "        a = a * 3 + " + n + ";\n"
+                "    }\n"
+                "    return a;\n"
+                "}\n";
+        // chained through acc, so the calls cannot leave the loop
+        loop += "        acc = hot" + n + "(acc);\n";
+    }
+    return source + "function real main() {\n"
+            "    let integer acc = 0;\n" + setup +
+            "    for (let integer i = 0; i < " + std::to_string(iterations) + "; i++) {\n" + loop +
+            "    }\n"
+            "    printinteger(acc);\n"
+            "    return 0.0;\n"
+            "}\n";
+}
+
+int main(int argc, char** argv) {
+
+    unsigned hot = argc > 1 ? atoi(argv[1]) : 200;
+    unsigned cold = argc > 2 ? atoi(argv[2]) : 2;
+    unsigned iterations = argc > 3 ? atoi(argv[3]) : 2000;
+    std::string source = generateSource(hot, cold, iterations);
+
+    for (bool layout : {false, true}) {
+        JITCompilerOptions options;
+        options.LayoutFunctions = layout;
+        auto compiler = llvm::cantFail(JITCompiler::Create(options));
+        std::string error;
+
+        auto start = std::chrono::steady_clock::now();
+        auto program = compiler->compile(source, "layout", error);
+        if (!program) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        double compileMs = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+
+        uintptr_t low = UINTPTR_MAX, high = 0;
+        std::set<uintptr_t> pages;
+        for (unsigned i = 0; i < hot; i++) {
+            auto *function = program->lookup<int64_t(int64_t)>("hot" + std::to_string(i), error);
+            if (!function) {
+                fprintf(stderr, "%s\n", error.c_str());
+                return 1;
+            }
+            low = std::min(low, (uintptr_t) function);
+            high = std::max(high, (uintptr_t) function);
+            pages.insert((uintptr_t) function >> 12);
+        }
+
+        auto *entry = program->getMain(error);
+        if (!entry) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        start = std::chrono::steady_clock::now();
+        entry();
+        double runMs = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+
+        printf("%-9s compile %.0f ms, hot functions span %zu KB on %zu pages, main %.1f ms\n",
+                layout ? "layout:" : "module:", compileMs, (high - low) >> 10, pages.size(), runMs);
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+// Lexer throughput on a synthetic program, in MB/s.
+//
+// usage: lexer_bench [input size in MB] [runs]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <llvm/Support/MemoryBuffer.h>
+#include "Lexer.h"
+#include "SourceManager.h"
+
+// functions mixing every kind of token, with distinct names
+static std::string generateSource(size_t bytes) {
+
+    std::string source = "extern integer printinteger(integer v);\n# synthetic input\n";
+    for (unsigned i = 0; source.size() < bytes; i++) {
+        std::string n = std::to_string(i);
+        source += "function real kernel" + n + "(integer count, real scale) {\n"
+                "    let real acc" + n + " = 0.0;\n"
+                "    for (let integer i = 0; i < count; i++) {\n"
+                "        if (i == 17) {\n"
+                "            acc" + n + " = acc" + n + " + scale * 3.14159265;\n"
+                "        } else {\n"
+                "            acc" + n + " = acc" + n + " - 0.5 * scale; # comment\n"
+                "        }\n"
+                "    }\n"
+                "    printinteger(count * 1000003 - " + n + ");\n"
+                "    return acc" + n + ";\n"
+                "}\n";
+    }
+    return source;
+}
+
+// best throughput of several runs of the given lexing loop
+template<typename F>
+static void report(const char* name, size_t bytes, int runs, F lex) {
+
+    double best = 0;
+    size_t tokens = 0;
+    for (int run = 0; run < runs; run++) {
+        auto start = std::chrono::steady_clock::now();
+        tokens = lex();
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        double throughput = bytes / seconds / (1 << 20);
+        best = throughput > best ? throughput : best;
+    }
+
+    printf("%-10s %.1f MB, %zu tokens: %.1f MB/s (best of %d)\n",
+            name, bytes / (double) (1 << 20), tokens, best, runs);
+}
+
+int main(int argc, char** argv) {
+
+    size_t megabytes = argc > 1 ? atoi(argv[1]) : 64;
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+
+    std::string source = generateSource(megabytes << 20);
+    unsigned FileID = SourceManager::get().addBuffer(
+            llvm::MemoryBuffer::getMemBufferCopy(source, "synthetic"), "synthetic");
+
+    // streaming lexer, scanning the source on demand
+    report("streaming", source.size(), runs, [&]() {
+        Lexer lexer(FileID);
+        size_t tokens = 1;
+        while (lexer.getCurrentToken() != tok_eof) {
+            lexer.getNextToken();
+            tokens++;
+        }
+        return tokens;
+    });
+
+    // building the token buffer
+    report("tokenize", source.size(), runs, [&]() {
+        return Lexer::tokenize(FileID)->size();
+    });
+
+    // walking an already built token buffer, as the parser does
+    auto buffer = Lexer::tokenize(FileID);
+    report("buffered", source.size(), runs, [&]() {
+        Lexer lexer(buffer);
+        size_t tokens = 1;
+        while (lexer.getCurrentToken() != tok_eof) {
+            lexer.getNextToken();
+            tokens++;
+        }
+        return tokens;
+    });
+    return 0;
+}
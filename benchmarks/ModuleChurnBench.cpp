@@ -0,0 +1,109 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+// Adds a module to the JIT, calls it and removes it, in a loop. Resident
+// memory should stay flat once the allocators are warm. With "keep", only
+// the symbols are dropped and the code stays mapped, for comparison.
+//
+// usage: module_churn [iterations] [functions per module] [keep]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TargetSelect.h"
+#include "JIT.h"
+#include "LLVMIRGen.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "SourceManager.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+static ExitOnError ExitOnErr;
+
+static std::string generateSource(unsigned functions) {
+    std::string source;
+    for (unsigned i = 0; i < functions; i++) {
+        std::string n = std::to_string(i);
+        source += "function integer churn" + n + "(integer count) {\n"
+                "    let integer acc = " + n + ";\n"
+                "    for (let integer i = 0; i < count; i++) {\n"
+                "        acc = acc * 3 + i;\n"
+                "    }\n"
+                "    return acc;\n"
+                "}\n";
+    }
+    return source;
+}
+
+static double residentMB() {
+    std::ifstream statm("/proc/self/statm");
+    size_t size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * (double) sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+int main(int argc, char** argv) {
+
+    unsigned iterations = argc > 1 ? atoi(argv[1]) : 20000;
+    unsigned functions = argc > 2 ? atoi(argv[2]) : 8;
+    bool keep = argc > 3 && strcmp(argv[3], "keep") == 0;
+
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+    InitializeNativeTargetAsmParser();
+    auto TheJIT = ExitOnErr(KaleidoscopeJIT::Create());
+
+    // parsed again at every iteration, the buffer is registered once
+    unsigned FileID = SourceManager::get().addBuffer(
+            MemoryBuffer::getMemBufferCopy(generateSource(functions), "churn"), "churn");
+
+    int64_t check = 0;
+    for (unsigned it = 1; it <= iterations; it++) {
+        auto context = std::make_unique<LLVMContext>();
+        LLVMIRGen<> generator(context.get());
+        Parser<LLVMValue> parser(std::make_unique<Lexer>(FileID));
+        while (auto exp = parser.nextConstruct()) {
+            generator.GenFromAST(std::move(exp));
+        }
+        std::unique_ptr<Module> module = generator.getModule();
+        module->setDataLayout(TheJIT->getDataLayout());
+
+        auto H = ExitOnErr(TheJIT->addModule(ThreadSafeModule(std::move(module), std::move(context))));
+        for (unsigned i = 0; i < functions; i++) {
+            auto Symbol = ExitOnErr(TheJIT->lookup("churn" + std::to_string(i)));
+            check += ((int64_t(*)(int64_t))(intptr_t) Symbol.getAddress())(10);
+        }
+
+        if (keep) {
+            for (unsigned i = 0; i < functions; i++) {
+                ExitOnErr(TheJIT->remove("churn" + std::to_string(i)));
+            }
+        } else {
+            ExitOnErr(TheJIT->removeModule(H));
+        }
+
+        if (it % (iterations < 10 ? 1 : iterations / 10) == 0) {
+            printf("%8u modules: %7.1f MB resident\n", it, residentMB());
+        }
+    }
+    printf("checksum %lld\n", (long long) check);
+    return 0;
+}
+
@@ -0,0 +1,84 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+// Compares ListSymbolTable and HashSymbolTable on the access pattern of the
+// IR generators: a function scope with many locals, nested block scopes,
+// and several lookups per declared variable.
+//
+// usage: symtable_bench [locals per function] [functions]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "ListSymbolTable.h"
+#include "HashSymbolTable.h"
+
+static const int LookupsPerLocal = 4;
+static const int LocalsPerBlock = 16;
+
+template<template<typename> class SymbolTable>
+static double run(const std::vector<Identifier>& names, int functions, long& checksum) {
+
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < functions; f++) {
+        SymbolTable<int> table;
+        table.push_scope();
+        for (int i = 0; i < (int) names.size(); i++) {
+            // a block scope every few declarations, like nested ifs/loops
+            if (i % LocalsPerBlock == 0 && i > 0) {
+                table.push_scope();
+            }
+            if (!table.contains(names[i])) {
+                table.insertSymbol(names[i], StorageType::LOCAL, i);
+            }
+            for (int l = 0; l < LookupsPerLocal; l++) {
+                checksum += table.getSymbol(names[(i * 7 + l) % (i + 1)])->getMemRef();
+            }
+        }
+        for (int i = LocalsPerBlock; i < (int) names.size(); i += LocalsPerBlock) {
+            table.pop_scope();
+        }
+        table.pop_scope();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+
+    int locals = argc > 1 ? atoi(argv[1]) : 4000;
+    int functions = argc > 2 ? atoi(argv[2]) : 10;
+
+    // names come interned from the lexer
+    std::vector<Identifier> names;
+    for (int i = 0; i < locals; i++) {
+        names.push_back(Identifier("local" + std::to_string(i)));
+    }
+
+    long listSum = 0, hashSum = 0;
+    double listMs = run<ListSymbolTable>(names, functions, listSum);
+    double hashMs = run<HashSymbolTable>(names, functions, hashSum);
+
+    if (listSum != hashSum) {
+        fprintf(stderr, "Symbol tables disagree (%ld != %ld)\n", listSum, hashSum);
+        return 1;
+    }
+
+    printf("%d functions x %d locals\n", functions, locals);
+    printf("ListSymbolTable: %10.2f ms\n", listMs);
+    printf("HashSymbolTable: %10.2f ms (%.1fx)\n", hashMs, listMs / hashMs);
+    return 0;
+}
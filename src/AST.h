@@ -25,14 +25,15 @@
 #include <iostream>
 
 #include "AbstractIRGen.h"
+#include "ASTArena.h"
 #include "LangDefs.h"
 #include "DebugInfo.h"
+#include "Identifier.h"
 
-class LLVMIRGen;
 
-/// BaseAST - base for all other classes
+/// BaseAST - base for all other classes, allocated in the arena of the parser
 template<typename T>
-class BaseAST {
+class BaseAST : public ArenaAllocated {
 public:
 
     BaseAST(std::unique_ptr<DebugInfo>&& DI) : DI(std::move(DI)) {
@@ -140,13 +141,13 @@ public:
 
 template<typename T>
 class LocalVarDeclarationExprAST : public ExprAST<T> {
-    std::string Name;
+    Identifier Name;
     std::unique_ptr<ExprAST<T>> Initializer;
     VarType Type;
 public:
 
     LocalVarDeclarationExprAST(std::unique_ptr<DebugInfo>&& DI,
-            const std::string &Name,
+            Identifier Name,
             std::unique_ptr<ExprAST<T>>&& Initializer,
             VarType Type) : ExprAST<T>(std::move(DI)), Name(Name), Initializer(std::move(Initializer)), Type(Type) {
     }
@@ -158,7 +159,7 @@ public:
         return visitor->visit(this);
     }
 
-    std::string& getName() {
+    Identifier getName() {
         return Name;
     }
 
@@ -175,11 +176,11 @@ public:
 
 template<typename T>
 class VariableExprAST : public ExprAST<T> {
-    std::string Name;
+    Identifier Name;
 
 public:
 
-    VariableExprAST(std::unique_ptr<DebugInfo>&& DI, const std::string &Name) : ExprAST<T>(std::move(DI)), Name(Name) {
+    VariableExprAST(std::unique_ptr<DebugInfo>&& DI, Identifier Name) : ExprAST<T>(std::move(DI)), Name(Name) {
     }
 
     virtual ~VariableExprAST() {
@@ -189,7 +190,7 @@ public:
         return visitor->visit(this);
     }
 
-    std::string& getName() {
+    Identifier getName() {
         return Name;
     }
 };
@@ -263,11 +264,11 @@ public:
 
 template<typename T>
 class AssignmentAST : public ExprAST<T> {
-    std::string VarName;
+    Identifier VarName;
     std::unique_ptr<ExprAST<T>> RHS;
 public:
 
-    AssignmentAST(std::unique_ptr<DebugInfo>&& DI, const std::string &VarName,
+    AssignmentAST(std::unique_ptr<DebugInfo>&& DI, Identifier VarName,
             std::unique_ptr<ExprAST<T>>&& RHS)
     : ExprAST<T>(std::move(DI)), VarName(VarName), RHS(std::move(RHS)) {
     }
@@ -309,12 +310,12 @@ public:
 
 template<typename T>
 class CallExprAST : public ExprAST<T> {
-    std::string Callee;
+    Identifier Callee;
     std::vector<std::unique_ptr<ExprAST<T>>> Args;
 
 public:
 
-    CallExprAST(std::unique_ptr<DebugInfo>&& DI, const std::string &Callee,
+    CallExprAST(std::unique_ptr<DebugInfo>&& DI, Identifier Callee,
             std::vector<std::unique_ptr<ExprAST<T>>>&& Args)
     : ExprAST<T>(std::move(DI)), Callee(Callee), Args(std::move(Args)) {
     }
@@ -323,7 +324,7 @@ public:
         return visitor->visit(this);
     }
 
-    std::string& getCalee() {
+    Identifier getCalee() {
         return Callee;
     }
 
@@ -333,15 +334,15 @@ public:
 };
 
 class Arg {
-    std::string Name;
+    Identifier Name;
     VarType type;
 
 public:
 
-    Arg(std::string Name, VarType type) : Name(Name), type(type) {
+    Arg(Identifier Name, VarType type) : Name(Name), type(type) {
     }
 
-    std::string& getName() {
+    Identifier getName() {
         return Name;
     }
 
@@ -357,12 +358,13 @@ public:
 
 template<typename T>
 class PrototypeAST : public PrimaryAST<T> {
-    std::string Name;
+    Identifier Name;
     std::vector<Arg> Args;
     VarType returnType;
+    InlineHint inlineHint = INLINE_DEFAULT;
 public:
 
-    PrototypeAST(std::unique_ptr<DebugInfo>&& DI, VarType returnType, const std::string &name, std::vector<Arg>&& Args)
+    PrototypeAST(std::unique_ptr<DebugInfo>&& DI, VarType returnType, Identifier name, std::vector<Arg>&& Args)
     : PrimaryAST<T>(std::move(DI)), returnType(returnType), Name(name), Args(std::move(Args)) {
     }
 
@@ -374,13 +376,21 @@ public:
         return returnType;
     }
 
-    const std::string &getName() const {
+    Identifier getName() const {
         return Name;
     }
 
     std::vector<Arg> &getArgs() {
         return Args;
     }
+
+    InlineHint getInlineHint() {
+        return inlineHint;
+    }
+
+    void setInlineHint(InlineHint hint) {
+        inlineHint = hint;
+    }
 };
 
 /// ExprBlockAST - This class represents a sequence of Expressions (block))
@@ -443,14 +453,23 @@ public:
         visitor->visit(this);
     }
 
-    const std::string &getName() const {
+    Identifier getName() const {
         return Proto->getName();
     }
 
+    InlineHint getInlineHint() {
+        return Proto->getInlineHint();
+    }
+
     std::unique_ptr<PrototypeAST<T>> getProto() {
         return std::move(Proto);
     }
 
+    // unlike getProto, leaves the prototype in the node
+    PrototypeAST<T>* peekProto() {
+        return Proto.get();
+    }
+
     std::unique_ptr<ExprBlockAST<T>> getBody() {
         return std::move(Body);
     }
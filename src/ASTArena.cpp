@@ -0,0 +1,106 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include "ASTArena.h"
+
+thread_local ASTArena* ASTArena::active = nullptr;
+
+// Every block starts with the arena it comes from (null for the heap), so
+// operator delete knows what to do with it. AST nodes and debug info do
+// not need more than pointer alignment.
+static const size_t HeaderSize = sizeof (ASTArena*);
+
+static size_t alignSize(size_t size) {
+    return (size + alignof (ASTArena*) - 1) & ~(alignof (ASTArena*) - 1);
+}
+
+ASTArena::~ASTArena() {
+    // a node outliving its arena would be deleted through a dangling
+    // pointer to it
+    assert(live.load() == 0 && "AST node outlives its arena");
+    release(0);
+}
+
+void ASTArena::newSlab(size_t size) {
+    size_t slabSize = size > SlabSize ? size : SlabSize;
+    char* slab = static_cast<char*> (std::malloc(slabSize));
+    if (!slab) {
+        throw std::bad_alloc();
+    }
+    slabs.push_back(slab);
+    current = slab;
+    end = slab + slabSize;
+}
+
+void* ASTArena::allocate(size_t size) {
+    size = alignSize(size);
+    if (current == nullptr || (size_t) (end - current) < size) {
+        newSlab(size);
+    }
+    void* ptr = current;
+    current += size;
+    bytesAllocated += size;
+    return ptr;
+}
+
+// free all slabs but the first keep ones
+void ASTArena::release(size_t keep) {
+    for (size_t i = keep; i < slabs.size(); i++) {
+        std::free(slabs[i]);
+    }
+    slabs.resize(keep < slabs.size() ? keep : slabs.size());
+    current = nullptr;
+    end = nullptr;
+}
+
+void ASTArena::reset() {
+    if (!isIdle() || slabs.empty()) {
+        return;
+    }
+    // the first slab is enough for most constructs, keep it
+    char* first = slabs[0];
+    release(1);
+    current = first;
+    end = first + SlabSize;
+    bytesAllocated = 0;
+}
+
+void* ArenaAllocated::operator new(size_t size) {
+    ASTArena* arena = ASTArena::getActive();
+    char* block;
+    if (arena) {
+        block = static_cast<char*> (arena->allocate(HeaderSize + size));
+        arena->live.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        block = static_cast<char*> (::operator new(HeaderSize + size));
+    }
+    *reinterpret_cast<ASTArena**> (block) = arena;
+    return block + HeaderSize;
+}
+
+void ArenaAllocated::operator delete(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    char* block = static_cast<char*> (ptr) - HeaderSize;
+    ASTArena* arena = *reinterpret_cast<ASTArena**> (block);
+    if (arena) {
+        arena->live.fetch_sub(1, std::memory_order_release);
+    } else {
+        ::operator delete(block);
+    }
+}
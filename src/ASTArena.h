@@ -0,0 +1,98 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef ASTARENA_H
+#define	ASTARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/// Bump pointer allocator for the AST of a compilation unit. Nodes are still
+/// owned through unique_ptrs and their destructors run as usual, but deleting
+/// a node does not free memory: the arena releases its slabs in one shot, or
+/// recycles them once every node allocated from it is gone. Every node must
+/// be deleted before its arena, deleting it touches the arena.
+
+class ASTArena {
+public:
+    ASTArena() = default;
+    ASTArena(const ASTArena&) = delete;
+    ASTArena& operator=(const ASTArena&) = delete;
+    ~ASTArena();
+
+    void* allocate(size_t size);
+
+    // Reuse the slabs for new nodes. Does nothing while some node allocated
+    // from the arena is alive.
+    void reset();
+
+    size_t getBytesAllocated() const {
+        return bytesAllocated;
+    }
+
+    // true if every node allocated from the arena is gone
+    bool isIdle() const {
+        return live.load(std::memory_order_acquire) == 0;
+    }
+
+    // Arena new nodes are allocated from in this thread, may be null
+    static ASTArena* getActive() {
+        return active;
+    }
+
+    /// Makes an arena the active one while the scope lives.
+
+    class Scope {
+    public:
+
+        Scope(ASTArena& arena) : previous(active) {
+            active = &arena;
+        }
+
+        ~Scope() {
+            active = previous;
+        }
+    private:
+        ASTArena* previous;
+    };
+
+private:
+    friend class ArenaAllocated;
+
+    static const size_t SlabSize = 64 * 1024;
+    static thread_local ASTArena* active;
+
+    std::vector<char*> slabs;
+    char* current = nullptr;
+    char* end = nullptr;
+    size_t bytesAllocated = 0;
+    // nodes not deleted yet, they can be deleted from other threads
+    std::atomic<size_t> live{0};
+
+    void newSlab(size_t size);
+    void release(size_t keep);
+};
+
+/// Base of the classes allocated in the active ASTArena of the thread, or in
+/// the heap when there is none.
+
+class ArenaAllocated {
+public:
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+};
+
+#endif	/* ASTARENA_H */
+
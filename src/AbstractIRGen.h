@@ -60,6 +60,15 @@ public:
     virtual T visit(CallExprAST<T>* node) = 0;
     virtual T visit(LocalVarDeclarationExprAST<T>* node) = 0;
     virtual std::unique_ptr<llvm::Module> getModule() = 0;
+    // Waits until every construct handed to GenFromAST is generated. The
+    // parsers own the AST, they must not go away before this returns.
+    virtual void finish() {
+    }
+    // Semantic errors found, like Parser::hasFail. The generated code is
+    // incomplete and must not be used.
+    virtual bool hasFail() {
+        return false;
+    }
 
 };
 
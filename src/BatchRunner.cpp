@@ -0,0 +1,120 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "BatchRunner.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double milliseconds(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct CompiledScript {
+    std::unique_ptr<CompiledProgram> program;
+    std::string error;
+    double compileTime;
+};
+
+static CompiledScript compileScript(JITCompiler& compiler, const std::string& filename) {
+
+    CompiledScript script;
+    auto start = Clock::now();
+    auto fileOrErr = llvm::MemoryBuffer::getFile(filename);
+    if (std::error_code ec = fileOrErr.getError()) {
+        script.error = "Could not open input file: " + ec.message();
+    } else {
+        script.program = compiler.compile(fileOrErr.get()->getBuffer().str(), filename,
+                script.error);
+    }
+    script.compileTime = milliseconds(start);
+    return script;
+}
+
+BatchRunner::BatchRunner(JITCompilerOptions Options) {
+    auto CompilerOrErr = JITCompiler::Create(std::move(Options));
+    if (!CompilerOrErr) {
+        fprintf(stderr, "Could not set up the JIT: %s\n", llvm::toString(CompilerOrErr.takeError()).c_str());
+        return;
+    }
+    compiler = std::move(*CompilerOrErr);
+}
+
+bool BatchRunner::readManifest(const std::string& manifest, std::vector<std::string>& scripts) {
+
+    auto fileOrErr = llvm::MemoryBuffer::getFile(manifest);
+    if (std::error_code ec = fileOrErr.getError()) {
+        fprintf(stderr, "Could not open manifest: %s\n", ec.message().c_str());
+        return false;
+    }
+    llvm::SmallVector<llvm::StringRef, 64> lines;
+    fileOrErr.get()->getBuffer().split(lines, '\n');
+    for (auto line : lines) {
+        line = line.trim();
+        if (!line.empty() && !line.startswith("#")) {
+            scripts.push_back(line.str());
+        }
+    }
+    return true;
+}
+
+int BatchRunner::run(const std::string& manifest) {
+
+    std::vector<std::string> scripts;
+    if (!compiler || !readManifest(manifest, scripts)) {
+        return -1;
+    }
+
+    int result = 0;
+    std::future<CompiledScript> next;
+    if (!scripts.empty()) {
+        next = std::async(std::launch::async, compileScript, std::ref(*compiler), scripts[0]);
+    }
+
+    for (size_t i = 0; i < scripts.size(); i++) {
+        CompiledScript script = next.get();
+        if (i + 1 < scripts.size()) {
+            next = std::async(std::launch::async, compileScript, std::ref(*compiler), scripts[i + 1]);
+        }
+
+        CompiledProgram::EntryPoint mainFn = nullptr;
+        if (script.program) {
+            mainFn = script.program->getMain(script.error);
+        }
+        if (!mainFn) {
+            fprintf(stderr, "%s\n", script.error.c_str());
+            printf("# %s: compile %.3f ms, status compile error\n", scripts[i].c_str(),
+                    script.compileTime);
+            fflush(stdout);
+            result = 1;
+            continue;
+        }
+
+        auto start = Clock::now();
+        mainFn();
+        double runTime = milliseconds(start);
+        // the code of the script goes away here
+        script.program.reset();
+
+        printf("# %s: compile %.3f ms, run %.3f ms, status ok\n", scripts[i].c_str(),
+                script.compileTime, runTime);
+        fflush(stdout);
+    }
+    return result;
+}
+
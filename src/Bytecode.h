@@ -0,0 +1,98 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef BYTECODE_H
+#define	BYTECODE_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "Identifier.h"
+#include "LangDefs.h"
+
+/// Opcodes of the tier-1 stack machine. The bytecode generator selects the
+/// typed variant (I for integer, R for real) of each operation, so the
+/// interpreter never checks types at runtime.
+
+enum class OpCode : uint8_t {
+    PushInt,
+    PushReal,
+    Load,
+    Store,
+    Dup,
+    Pop,
+    AddI,
+    AddR,
+    SubI,
+    SubR,
+    MulI,
+    MulR,
+    EqI,
+    EqR,
+    LtI,
+    LtR,
+    Jump,
+    JumpIfFalse,
+    // backward jump of a loop, also bumps the function hotness counter
+    LoopBack,
+    // calls a defined function or an extern, depending on the callee
+    Call,
+    Ret,
+    RetVoid
+};
+
+/// A value on the interpreter stack. Predicates are stored as integers 0/1.
+
+union BCSlot {
+    int64_t i;
+    double r;
+};
+
+struct BCInstruction {
+    OpCode op;
+    // local slot, jump target or callee index, depending on the opcode
+    int32_t a;
+    // immediate for PushInt/PushReal
+    BCSlot imm;
+};
+
+struct BCFunction {
+    std::string name;
+    VarType returnType;
+    std::vector<VarType> argTypes;
+    std::vector<Identifier> argNames;
+    // false for extern prototypes, which are resolved in the host process
+    bool defined = false;
+    // types of the frame slots, parameters first
+    std::vector<VarType> slotTypes;
+    unsigned maxStack = 0;
+    std::vector<BCInstruction> code;
+};
+
+struct BytecodeModule {
+    std::vector<BCFunction> functions;
+    std::map<std::string, unsigned> index;
+
+    int lookup(const std::string& name) const {
+        auto it = index.find(name);
+        if (it == index.end()) {
+            return -1;
+        }
+        return it->second;
+    }
+};
+
+#endif	/* BYTECODE_H */
+
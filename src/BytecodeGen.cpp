@@ -0,0 +1,537 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "BytecodeGen.h"
+
+// The checks below mirror the ones in LLVMIRGen: every program accepted by the
+// interpreter tier must also be accepted when a function is promoted to the
+// JIT tier, which is generated from the same source.
+
+static void abort(const char *Str, std::string loc) {
+    printf("Code generator fatal: %s -> %s\n", Str, loc.c_str());
+    exit(-1);
+}
+
+static void abort(const char *Str, std::string msg, std::string loc) {
+    printf("Code generator fatal: %s (%s) -> %s\n", Str, msg.c_str(), loc.c_str());
+    exit(-1);
+}
+
+BytecodeGen::BytecodeGen() : AbstractIRGen<BCValue>() {
+    TheModule = std::make_unique<BytecodeModule>();
+}
+
+// Entry point of the bytecode generator. Using a visitor design pattern.
+
+void BytecodeGen::GenFromAST(std::unique_ptr<PrimaryAST<BCValue>> node) {
+    node->acceptIRGenVisitor(this);
+}
+
+// Prototype overload.
+
+void BytecodeGen::visit(PrototypeAST<BCValue>* proto) {
+    declareFunction(proto);
+}
+
+// Register a function (defined or extern) and return its index.
+
+int BytecodeGen::declareFunction(PrototypeAST<BCValue>* node) {
+
+    const std::string& Name = node->getName().str();
+    int idx = TheModule->lookup(Name);
+    if (idx >= 0) {
+        return idx;
+    }
+
+    BCFunction function;
+    function.name = Name;
+    function.returnType = node->getReturnType();
+    for (auto &arg : node->getArgs()) {
+        function.argTypes.push_back(arg.getType());
+        function.argNames.push_back(arg.getName());
+    }
+
+    idx = TheModule->functions.size();
+    TheModule->functions.push_back(std::move(function));
+    TheModule->index[Name] = idx;
+    return idx;
+}
+
+// FunctionAST overload.
+
+void BytecodeGen::visit(FunctionAST<BCValue>* node) {
+
+    const std::string& Name = node->getName().str();
+    auto DI = node->getDebugInfo();
+    int idx = TheModule->lookup(Name);
+    if (idx < 0) {
+        // generator must owns the prototype pointer
+        std::unique_ptr<PrototypeAST < BCValue>> proto = node->getProto();
+        idx = declareFunction(proto.get());
+    }
+
+    BCFunction* function = &TheModule->functions[idx];
+    if (function->defined) {
+        abort("Function already defined", Name, DI->getInfo());
+    }
+    function->defined = true;
+    currentFunction = function;
+    stackDepth = 0;
+
+    // parameters take the first slots of the frame, in order
+    symbolTable.push_scope();
+    for (unsigned i = 0; i < function->argNames.size(); i++) {
+        symbolTable.insertSymbol(function->argNames[i], StorageType::LOCAL, i);
+        function->slotTypes.push_back(function->argTypes[i]);
+    }
+
+    std::unique_ptr<ExprBlockAST < BCValue>> block = node->getBody();
+    while (!block->empty()) {
+        visitStatement(block->nextExp());
+    }
+    symbolTable.pop_scope();
+
+    // the parser guarantees a trailing return, this only protects the
+    // interpreter from running past the end of the code.
+    if (function->returnType == NONE) {
+        emit(OpCode::RetVoid);
+    } else {
+        if (function->returnType == REAL) {
+            emitReal(0.0);
+        } else {
+            emitInteger(0);
+        }
+        emit(OpCode::Ret);
+    }
+
+    currentFunction = nullptr;
+}
+
+// Generate code for a block, its declarations die at the end of the block.
+
+void BytecodeGen::visitExpBlock(std::unique_ptr<ExprBlockAST<BCValue>> block) {
+
+    symbolTable.push_scope();
+    while (!block->empty()) {
+        visitStatement(block->nextExp());
+    }
+    symbolTable.pop_scope();
+}
+
+// Expressions used as statements must not leave values on the stack.
+
+void BytecodeGen::visitStatement(std::unique_ptr<ExprAST<BCValue>> expr) {
+    BCValue value = expr->acceptIRGenVisitor(this);
+    if (!value.isNone()) {
+        emit(OpCode::Pop);
+    }
+}
+
+void BytecodeGen::visitCondition(std::unique_ptr<ExprAST<BCValue>> cond, DebugInfo* DI) {
+    BCValue value = cond->acceptIRGenVisitor(this);
+    if (!value.isPredicate()) {
+        abort("Condition must be a comparison", DI->getInfo());
+    }
+}
+
+int BytecodeGen::allocLocalVar(Identifier name, VarType type, DebugInfo* DI) {
+
+    if (symbolTable.contains(name)) {
+        abort("Variable already declared", name.str(), DI->getInfo());
+    }
+
+    int slot = currentFunction->slotTypes.size();
+    currentFunction->slotTypes.push_back(type);
+    symbolTable.insertSymbol(name, StorageType::LOCAL, slot);
+    return slot;
+}
+
+void BytecodeGen::visit(IfExprAST<BCValue>* ifexp) {
+
+    auto DI = ifexp->getDebugInfo();
+    std::unique_ptr<ExprBlockAST < BCValue>> ThenBlock = ifexp->getThen();
+    std::unique_ptr<ExprBlockAST < BCValue>> ElseBlock = ifexp->getElse();
+
+    visitCondition(ifexp->getCondition(), DI.get());
+    size_t toElse = emit(OpCode::JumpIfFalse);
+
+    visitExpBlock(std::move(ThenBlock));
+
+    // we deal with else blocks as optional
+    if (ElseBlock) {
+        size_t toCont = emit(OpCode::Jump);
+        patchJump(toElse);
+        visitExpBlock(std::move(ElseBlock));
+        patchJump(toCont);
+    } else {
+        patchJump(toElse);
+    }
+}
+
+// VariableExprAST overload
+
+BCValue BytecodeGen::visit(VariableExprAST<BCValue>* node) {
+
+    auto DI = node->getDebugInfo();
+    if (!symbolTable.contains(node->getName())) {
+        abort("Variable not found", node->getName().str(), DI->getInfo());
+    }
+
+    Symbol<int>* symbol = symbolTable.getSymbol(node->getName());
+    int slot = symbol->getMemRef();
+    emit(OpCode::Load, slot);
+
+    return BCValue(currentFunction->slotTypes[slot]);
+}
+
+// RealNumberExprAST overload.
+
+BCValue BytecodeGen::visit(RealNumberExprAST<BCValue>* node) {
+    emitReal(node->getVal());
+    return BCValue(REAL);
+}
+
+// IntegerNumberExprAST overload.
+
+BCValue BytecodeGen::visit(IntegerNumberExprAST<BCValue>* node) {
+    emitInteger(node->getVal());
+    return BCValue(INTEGER);
+}
+
+// BinaryExprAST overload.
+
+BCValue BytecodeGen::visit(BinaryExprAST<BCValue>* node) {
+
+    auto DI = node->getDebugInfo();
+    Operation Op = node->getOp();
+    std::unique_ptr<ExprAST < BCValue>> LHS = node->getLHS();
+    std::unique_ptr<ExprAST < BCValue>> RHS = node->getRHS();
+
+    if (Op == Operation::ASSIGN) {
+        // Assignment requires the LHS to be an identifier (no RTTI, see LLVMIRGen).
+        VariableExprAST<BCValue> *LHSE = static_cast<VariableExprAST<BCValue> *> (LHS.get());
+        BCValue Val = RHS->acceptIRGenVisitor(this);
+
+        Symbol<int>* symb = symbolTable.getSymbol(LHSE->getName());
+        if (!symb) {
+            abort("Unknown variable name", LHSE->getName().str(), DI->getInfo());
+        }
+
+        int slot = symb->getMemRef();
+        if (Val != BCValue(currentFunction->slotTypes[slot])) {
+            abort("Type incompatibility between variable and assigned value", DI->getInfo());
+        }
+
+        // the assignment is an expression, keep a copy of the value
+        emit(OpCode::Dup);
+        emit(OpCode::Store, slot);
+        return Val;
+    }
+
+    BCValue L = LHS->acceptIRGenVisitor(this);
+    BCValue R = RHS->acceptIRGenVisitor(this);
+
+    if (L != R) {
+        abort("Type incompatibility between operands", DI->getInfo());
+    }
+    if (L.isPredicate() || (L.getType() != REAL && L.getType() != INTEGER)) {
+        abort("Unimplemented operand type", DI->getInfo());
+    }
+
+    bool real = L.getType() == REAL;
+    switch (Op) {
+        case Operation::ADD:
+            emit(real ? OpCode::AddR : OpCode::AddI);
+            return L;
+        case Operation::SUB:
+            emit(real ? OpCode::SubR : OpCode::SubI);
+            return L;
+        case Operation::MUL:
+            emit(real ? OpCode::MulR : OpCode::MulI);
+            return L;
+        case Operation::EQ:
+            emit(real ? OpCode::EqR : OpCode::EqI);
+            return BCValue(INTEGER, true);
+        case Operation::LT:
+            emit(real ? OpCode::LtR : OpCode::LtI);
+            return BCValue(INTEGER, true);
+        default:
+            abort("Unknown operand: ", std::string(1, Op));
+            break;
+    }
+
+    return nullptr;
+}
+
+BCValue BytecodeGen::visit(UnaryExprAST<BCValue>* node) {
+
+    auto DI = node->getDebugInfo();
+    std::unique_ptr<ExprAST < BCValue>> LRHS = node->getLRHS();
+    Operation op = node->getOp();
+    bool isPrefixed = node->isPrefix();
+
+    VariableExprAST<BCValue> *LHSE = static_cast<VariableExprAST<BCValue> *> (LRHS.get());
+    BCValue var = LHSE->acceptIRGenVisitor(this);
+    int slot = symbolTable.getSymbol(LHSE->getName())->getMemRef();
+    bool real = var.getType() == REAL;
+
+    // postfix operators return the value before the update
+    if (!isPrefixed) {
+        emit(OpCode::Dup);
+    }
+
+    switch (op) {
+        case Operation::INC:
+            real ? emitReal(1.0) : emitInteger(1);
+            emit(real ? OpCode::AddR : OpCode::AddI);
+            break;
+        case Operation::DEC:
+            real ? emitReal(1.0) : emitInteger(1);
+            emit(real ? OpCode::SubR : OpCode::SubI);
+            break;
+        default:
+            abort("Unimplemented unary operator", DI->getInfo());
+    }
+
+    if (isPrefixed) {
+        emit(OpCode::Dup);
+    }
+    emit(OpCode::Store, slot);
+
+    return var;
+}
+
+// ReturnAST overload
+
+void BytecodeGen::visit(ReturnAST<BCValue>* ifexp) {
+
+    auto DI = ifexp->getDebugInfo();
+    std::unique_ptr<ExprAST < BCValue>> RHS = ifexp->getExpr();
+
+    /// we have a void return
+    if (currentFunction->returnType == NONE) {
+        if (RHS) {
+            abort("Void functions cannot return a value", DI->getInfo());
+        }
+        emit(OpCode::RetVoid);
+        return;
+    }
+
+    if (!RHS) {
+        abort("A non void function must return a value", DI->getInfo());
+    }
+
+    BCValue Expr = RHS->acceptIRGenVisitor(this);
+    if (Expr != BCValue(currentFunction->returnType)) {
+        abort("Type incompatibility between returned expression and function's return type", DI->getInfo());
+    }
+    emit(OpCode::Ret);
+}
+
+// CallExprAST overload
+
+BCValue BytecodeGen::visit(CallExprAST<BCValue>* node) {
+
+    auto DI = node->getDebugInfo();
+    int idx = TheModule->lookup(node->getCalee().str());
+    if (idx < 0) {
+        abort("Unknown function referenced", node->getCalee().str(), DI->getInfo());
+    }
+
+    std::vector<std::unique_ptr < ExprAST < BCValue>>> Args = node->getArgs();
+    // If argument mismatch error.
+    if (TheModule->functions[idx].argTypes.size() != Args.size()) {
+        abort("Incorrect # arguments passed", DI->getInfo());
+    }
+
+    for (unsigned i = 0, e = Args.size(); i != e; ++i) {
+        BCValue Arg = Args[i]->acceptIRGenVisitor(this);
+        if (Arg != BCValue(TheModule->functions[idx].argTypes[i])) {
+            abort("Type incompatibility between provided and expected arguments", DI->getInfo());
+        }
+    }
+
+    // the callee may be defined later, so decide the kind of call by its
+    // state at execution time, not now.
+    BCFunction& callee = TheModule->functions[idx];
+    emit(OpCode::Call, idx);
+    stackDepth -= Args.size();
+
+    if (callee.returnType == NONE) {
+        return nullptr;
+    }
+    stackDepth++;
+    currentFunction->maxStack = std::max(currentFunction->maxStack, stackDepth);
+    return BCValue(callee.returnType);
+}
+
+// LocalVarDeclarationExprAST overload
+
+BCValue BytecodeGen::visit(LocalVarDeclarationExprAST<BCValue>* node) {
+
+    auto DI = node->getDebugInfo();
+    Identifier name = node->getName();
+    std::unique_ptr<ExprAST < BCValue>> Exp = node->getInitalizer();
+    VarType type = node->getType();
+    int slot = allocLocalVar(name, type, DI.get());
+
+    if (Exp) {
+        BCValue initializer = Exp->acceptIRGenVisitor(this);
+        if (initializer != BCValue(type)) {
+            abort("Type incompatibility between variable and its initializer", DI->getInfo());
+        }
+    } else {
+        // allocas are not initialized in the JIT tier, zero is as good as any
+        type == REAL ? emitReal(0.0) : emitInteger(0);
+    }
+    emit(OpCode::Store, slot);
+
+    return nullptr;
+}
+
+// ForExprAST overload
+
+void BytecodeGen::visit(ForExprAST<BCValue>* forExpr) {
+
+    auto DI = forExpr->getDebugInfo();
+    std::unique_ptr<ExprBlockAST < BCValue>> Block = forExpr->getBody();
+    std::unique_ptr<ExprAST < BCValue>> Start = forExpr->getStart();
+    std::unique_ptr<ExprAST < BCValue>> Cond = forExpr->getCond();
+    std::unique_ptr<ExprAST < BCValue>> End = forExpr->getEnd();
+
+    // scope for declared variables
+    symbolTable.push_scope();
+
+    if (Start) {
+        visitStatement(std::move(Start));
+    }
+
+    size_t header = currentPosition();
+    size_t toCont;
+    bool hasCond = (bool) Cond;
+    if (hasCond) {
+        visitCondition(std::move(Cond), DI.get());
+        toCont = emit(OpCode::JumpIfFalse);
+    }
+
+    if (Block) {
+        visitExpBlock(std::move(Block));
+    }
+    if (End) {
+        visitStatement(std::move(End));
+    }
+    emit(OpCode::LoopBack, header);
+
+    //without a condiction we have an infinite loop
+    if (hasCond) {
+        patchJump(toCont);
+    }
+    symbolTable.pop_scope();
+}
+
+// WhileExprAST overload
+
+void BytecodeGen::visit(WhileExprAST<BCValue>* whileExpr) {
+
+    auto DI = whileExpr->getDebugInfo();
+    std::unique_ptr<ExprBlockAST < BCValue>> Block = whileExpr->getBody();
+
+    size_t header = currentPosition();
+    visitCondition(whileExpr->getCond(), DI.get());
+    size_t toCont = emit(OpCode::JumpIfFalse);
+
+    if (Block) {
+        visitExpBlock(std::move(Block));
+    }
+    emit(OpCode::LoopBack, header);
+    patchJump(toCont);
+}
+
+// Append an instruction to the current function, tracking the operand stack
+// depth so the interpreter can size frames up front.
+
+size_t BytecodeGen::emit(OpCode op, int32_t a) {
+
+    switch (op) {
+        case OpCode::PushInt:
+        case OpCode::PushReal:
+        case OpCode::Load:
+        case OpCode::Dup:
+            stackDepth++;
+            break;
+        case OpCode::Store:
+        case OpCode::Pop:
+        case OpCode::AddI:
+        case OpCode::AddR:
+        case OpCode::SubI:
+        case OpCode::SubR:
+        case OpCode::MulI:
+        case OpCode::MulR:
+        case OpCode::EqI:
+        case OpCode::EqR:
+        case OpCode::LtI:
+        case OpCode::LtR:
+        case OpCode::JumpIfFalse:
+        case OpCode::Ret:
+            stackDepth--;
+            break;
+        default:
+            // calls are accounted by the caller of emit
+            break;
+    }
+    currentFunction->maxStack = std::max(currentFunction->maxStack, stackDepth);
+
+    BCInstruction inst;
+    inst.op = op;
+    inst.a = a;
+    inst.imm.i = 0;
+    currentFunction->code.push_back(inst);
+    return currentFunction->code.size() - 1;
+}
+
+size_t BytecodeGen::emitInteger(int64_t value) {
+    size_t at = emit(OpCode::PushInt);
+    currentFunction->code[at].imm.i = value;
+    return at;
+}
+
+size_t BytecodeGen::emitReal(double value) {
+    size_t at = emit(OpCode::PushReal);
+    currentFunction->code[at].imm.r = value;
+    return at;
+}
+
+// Make a forward jump target the next instruction to be emitted.
+
+void BytecodeGen::patchJump(size_t at) {
+    currentFunction->code[at].a = currentPosition();
+}
+
+size_t BytecodeGen::currentPosition() {
+    return currentFunction->code.size();
+}
+
+std::unique_ptr<llvm::Module> BytecodeGen::getModule() {
+    return nullptr;
+}
+
+// Transfer the bytecode out of this object.
+
+std::unique_ptr<BytecodeModule> BytecodeGen::getBytecode() {
+    return std::move(TheModule);
+}
@@ -0,0 +1,105 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef BYTECODEGEN_H
+#define	BYTECODEGEN_H
+
+#include <cstddef>
+#include <memory>
+#include "AST.h"
+#include "HashSymbolTable.h"
+#include "LangDefs.h"
+#include "AbstractIRGen.h"
+#include "Bytecode.h"
+
+/// Static type of an expression compiled to bytecode. Comparisons produce
+/// predicates, which are kept apart from integers to reject the same programs
+/// the LLVM IR generator rejects (i1 vs i64).
+
+class BCValue {
+public:
+
+    BCValue(std::nullptr_t) : type(NONE), predicate(false) {
+    }
+
+    BCValue(VarType type, bool predicate = false) : type(type), predicate(predicate) {
+    }
+
+    VarType getType() const {
+        return type;
+    }
+
+    bool isPredicate() const {
+        return predicate;
+    }
+
+    bool isNone() const {
+        return type == NONE && !predicate;
+    }
+
+    bool operator==(const BCValue& other) const {
+        return type == other.type && predicate == other.predicate;
+    }
+
+    bool operator!=(const BCValue& other) const {
+        return !(*this == other);
+    }
+
+private:
+    VarType type;
+    bool predicate;
+};
+
+// consumes the AST generating bytecode for the tier-1 interpreter
+class BytecodeGen : public AbstractIRGen<BCValue> {
+public:
+    BytecodeGen();
+    virtual void GenFromAST(std::unique_ptr<PrimaryAST<BCValue>> node) override;
+    virtual void visit(PrototypeAST<BCValue>* node) override;
+    virtual void visit(FunctionAST<BCValue>* node) override;
+    virtual void visit(IfExprAST<BCValue>* ifexp) override;
+    virtual void visit(ReturnAST<BCValue>* ifexp) override;
+    virtual void visit(ForExprAST<BCValue>* node) override;
+    virtual void visit(WhileExprAST<BCValue>* node) override;
+    virtual BCValue visit(VariableExprAST<BCValue>* node) override;
+    virtual BCValue visit(RealNumberExprAST<BCValue>* node) override;
+    virtual BCValue visit(IntegerNumberExprAST<BCValue>* node) override;
+    virtual BCValue visit(BinaryExprAST<BCValue>* node) override;
+    virtual BCValue visit(UnaryExprAST<BCValue>* node) override;
+    virtual BCValue visit(CallExprAST<BCValue>* node) override;
+    virtual BCValue visit(LocalVarDeclarationExprAST<BCValue>* node) override;
+    // bytecode is not lowered to LLVM IR, see getBytecode()
+    virtual std::unique_ptr<llvm::Module> getModule() override;
+    std::unique_ptr<BytecodeModule> getBytecode();
+
+private:
+    std::unique_ptr<BytecodeModule> TheModule;
+    HashSymbolTable<int> symbolTable;
+    BCFunction* currentFunction = nullptr;
+    unsigned stackDepth = 0;
+
+    int declareFunction(PrototypeAST<BCValue>* node);
+    void visitExpBlock(std::unique_ptr<ExprBlockAST<BCValue>> block);
+    void visitStatement(std::unique_ptr<ExprAST<BCValue>> expr);
+    void visitCondition(std::unique_ptr<ExprAST<BCValue>> cond, DebugInfo* DI);
+    int allocLocalVar(Identifier name, VarType type, DebugInfo* DI);
+    size_t emit(OpCode op, int32_t a = 0);
+    size_t emitInteger(int64_t value);
+    size_t emitReal(double value);
+    void patchJump(size_t at);
+    size_t currentPosition();
+};
+
+#endif	/* BYTECODEGEN_H */
+
@@ -0,0 +1,256 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "Daemon.h"
+
+using Clock = std::chrono::steady_clock;
+
+// warms up the lazily initialized parts of LLVM before the first fork
+static const char* WarmUpSource = "function integer warmup(integer x) {\n    return x + 1;\n}\n";
+
+static void logError(const char *Str) {
+    fprintf(stderr, "Daemon error: %s: %s\n", Str, strerror(errno));
+}
+
+static bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool readAll(int fd, std::string& data) {
+    char buffer[1 << 16];
+    while (true) {
+        ssize_t size = read(fd, buffer, sizeof(buffer));
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size < 0) {
+            return false;
+        }
+        if (size == 0) {
+            return true;
+        }
+        data.append(buffer, size);
+    }
+}
+
+static double milliseconds(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static int openSocket(const std::string& socketPath, sockaddr_un& address) {
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath.c_str());
+    return socket(AF_UNIX, SOCK_STREAM, 0);
+}
+
+Daemon::Daemon(JITCompilerOptions Options, unsigned timeout) : timeout(timeout) {
+    // every job is a fork of this process, and a SlabPool cannot be shared
+    // across fork()
+    if (Options.PooledMemory) {
+        fprintf(stderr, "Daemon warning: pooled JIT memory is not supported, it is disabled\n");
+        Options.PooledMemory = false;
+        Options.HugePages = false;
+    }
+    auto CompilerOrErr = JITCompiler::Create(std::move(Options));
+    if (!CompilerOrErr) {
+        fprintf(stderr, "Daemon error: cannot set up the JIT: %s\n",
+                llvm::toString(CompilerOrErr.takeError()).c_str());
+        return;
+    }
+    compiler = std::move(*CompilerOrErr);
+    std::string error;
+    if (!compiler->compile(WarmUpSource, "<warmup>", error)) {
+        fprintf(stderr, "Daemon error: warm up failed: %s\n", error.c_str());
+    }
+}
+
+int Daemon::serve(const std::string& socketPath) {
+
+    if (!compiler) {
+        return -1;
+    }
+
+    sockaddr_un address;
+    int listener = openSocket(socketPath, address);
+    if (listener < 0) {
+        logError("cannot create the socket");
+        return -1;
+    }
+    unlink(socketPath.c_str());
+    if (bind(listener, (sockaddr*) &address, sizeof(address)) < 0 || listen(listener, 128) < 0) {
+        logError("cannot listen on the socket");
+        return -1;
+    }
+
+    // job processes are reaped by the kernel, a client going away only
+    // fails the writes to its connection
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "Daemon listening on %s\n", socketPath.c_str());
+
+    while (true) {
+        int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno != EINTR) {
+                logError("accept failed");
+            }
+            continue;
+        }
+
+        std::string name = "job " + std::to_string(++jobs);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listener);
+            handle(connection, name);
+            _exit(0);
+        }
+        if (pid < 0) {
+            logError("cannot fork the job process");
+        }
+        close(connection);
+    }
+}
+
+// Body of the job process, the connection becomes its stdout and stderr so
+// diagnostics and program output go to the client.
+
+void Daemon::handle(int connection, const std::string& name) {
+
+    std::string source;
+    if (!readAll(connection, source)) {
+        return;
+    }
+    dup2(connection, STDOUT_FILENO);
+    dup2(connection, STDERR_FILENO);
+    close(connection);
+
+    // a SIGCHLD handler set to SIG_IGN would keep waitpid from seeing the sandbox
+    signal(SIGCHLD, SIG_DFL);
+
+    auto start = Clock::now();
+    std::string error;
+    auto program = compiler->compile(source, name, error);
+    double compileTime = milliseconds(start);
+    // diagnostics of the code generator go before the status line
+    fflush(stdout);
+    if (!program) {
+        std::string answer = error + "\n# " + name + ": status compile error\n";
+        writeAll(STDOUT_FILENO, answer.data(), answer.size());
+        return;
+    }
+
+    CompiledProgram::EntryPoint mainFn = program->getMain(error);
+    if (!mainFn) {
+        std::string answer = error + "\n# " + name + ": status compile error\n";
+        writeAll(STDOUT_FILENO, answer.data(), answer.size());
+        return;
+    }
+
+    start = Clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        // the default action of SIGALRM ends the sandbox
+        alarm(timeout);
+        mainFn();
+        fflush(nullptr);
+        _exit(0);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0) {
+        status = -1;
+    }
+    double runTime = milliseconds(start);
+
+    std::string result;
+    if (status < 0) {
+        result = "cannot run the sandbox";
+    } else if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        result = "ok";
+    } else if (WIFEXITED(status)) {
+        result = "exit " + std::to_string(WEXITSTATUS(status));
+    } else if (WTERMSIG(status) == SIGALRM) {
+        result = "timeout";
+    } else {
+        result = "signal " + std::to_string(WTERMSIG(status));
+    }
+
+    char times[96];
+    snprintf(times, sizeof(times), ": compile %.3f ms, run %.3f ms, status ", compileTime, runTime);
+    std::string answer = "# " + name + times + result + "\n";
+    writeAll(STDOUT_FILENO, answer.data(), answer.size());
+}
+
+int Daemon::submit(const std::string& socketPath, const std::string& source) {
+
+    sockaddr_un address;
+    int connection = openSocket(socketPath, address);
+    if (connection < 0 || connect(connection, (sockaddr*) &address, sizeof(address)) < 0) {
+        logError("cannot connect to the daemon");
+        return -1;
+    }
+    if (!writeAll(connection, source.data(), source.size()) || shutdown(connection, SHUT_WR) < 0) {
+        logError("cannot send the job");
+        return -1;
+    }
+
+    // streamed to stdout, the tail is kept to find the status
+    std::string tail;
+    char buffer[1 << 16];
+    ssize_t size;
+    while ((size = read(connection, buffer, sizeof(buffer))) != 0) {
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logError("cannot read the answer");
+            return -1;
+        }
+        fwrite(buffer, 1, size, stdout);
+        tail.append(buffer, size);
+        if (tail.size() > 256) {
+            tail.erase(0, tail.size() - 256);
+        }
+    }
+    fflush(stdout);
+    close(connection);
+
+    const std::string ok = "status ok\n";
+    return tail.size() >= ok.size() && tail.compare(tail.size() - ok.size(), ok.size(), ok) == 0 ? 0 : 1;
+}
+
@@ -0,0 +1,62 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef DAEMON_H
+#define	DAEMON_H
+
+#include <memory>
+#include <string>
+#include "JITCompiler.h"
+
+/// Compile server. Listens on a local Unix socket; a job is the source of a
+/// program, sent by the client before it shuts down its side of the
+/// connection. The answer streams back the diagnostics and the output of the
+/// program, and ends with a status line:
+///
+///     # <job>: compile 1.250 ms, run 0.100 ms, status ok
+///
+/// status is ok, "compile error", "signal N", "exit N" or timeout.
+///
+/// Target initialization and the JIT are set up once, before serving. Every
+/// connection is handled by a forked process that inherits them, so jobs
+/// run in parallel. main runs in a second fork, the sandbox, killed if it
+/// takes too long.
+///
+/// PooledMemory is ignored, the slabs of a SlabPool cannot be shared by the
+/// forked jobs.
+
+class Daemon {
+public:
+    // timeout in seconds for each execution, 0 for none
+    Daemon(JITCompilerOptions Options, unsigned timeout);
+
+    // Serves until the process is killed, -1 if the JIT or the socket cannot
+    // be set up.
+    int serve(const std::string& socketPath);
+
+    // Client side: sends a job and copies the answer to stdout. Returns 0
+    // if the job ended with status ok.
+    static int submit(const std::string& socketPath, const std::string& source);
+
+private:
+    // nullptr if the JIT could not be set up
+    std::unique_ptr<JITCompiler> compiler;
+    unsigned timeout;
+    unsigned jobs = 0;
+
+    void handle(int connection, const std::string& name);
+};
+
+#endif	/* DAEMON_H */
+
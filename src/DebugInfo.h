@@ -8,28 +8,35 @@
 #ifndef DEBUGINFO_H
 #define	DEBUGINFO_H
 
+#include <cstdint>
 #include <string>
+#include "ASTArena.h"
+#include "SourceManager.h"
 
-class DebugInfo {
+/// Location of an AST node: a byte offset into a buffer of the
+/// SourceManager. Line, column and text are only computed for diagnostics.
+
+class DebugInfo : public ArenaAllocated {
 public:
-   
 
-    DebugInfo(int line, int column, std::string file, std::string LineStr) : line(line), column(column), file(file), LineStr(LineStr) {
+    DebugInfo(unsigned FileID, uint32_t offset) : FileID(FileID), offset(offset) {
     }
-    
-    virtual ~DebugInfo() {}
 
     std::string getInfo() {
-        std::string str = std::string(file);
-        str.append(": line " + std::to_string(line) + " col " + std::to_string(column) + ": " + LineStr);
-        return str;
+        return SourceManager::get().describe(FileID, offset);
+    }
+
+    unsigned getFileID() {
+        return FileID;
+    }
+
+    uint32_t getOffset() {
+        return offset;
     }
 
 private:
-    int line;
-    int column;
-    std::string file;
-    std::string LineStr;
+    uint32_t FileID;
+    uint32_t offset;
 };
 
 
@@ -0,0 +1,100 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include "DiskObjectCache.h"
+
+std::string DiskObjectCache::getCachePath(const Module *M) {
+
+    std::string IR;
+    raw_string_ostream OS(IR);
+    M->print(OS, nullptr);
+    OS.flush();
+
+    MD5 Hash;
+    Hash.update(Config);
+    Hash.update(IR);
+    MD5::MD5Result Result;
+    Hash.final(Result);
+
+    SmallString<128> Path(CacheDir);
+    sys::path::append(Path, Result.digest().str() + ".o");
+    return Path.str().str();
+}
+
+std::unique_ptr<MemoryBuffer> DiskObjectCache::getObject(const Module *M) {
+
+    std::string Path = getCachePath(M);
+    auto Obj = MemoryBuffer::getFile(Path, -1, false);
+    if (Obj) {
+        return std::move(*Obj);
+    }
+
+    // a miss, the object will be compiled and handed to notifyObjectCompiled
+    std::lock_guard<std::mutex> Lock(PendingMutex);
+    PendingPaths[M] = Path;
+    return nullptr;
+}
+
+void DiskObjectCache::notifyObjectCompiled(const Module *M, MemoryBufferRef Obj) {
+
+    std::string Path;
+    {
+        std::lock_guard<std::mutex> Lock(PendingMutex);
+        auto It = PendingPaths.find(M);
+        if (It == PendingPaths.end()) {
+            Path = getCachePath(M);
+        } else {
+            Path = std::move(It->second);
+            PendingPaths.erase(It);
+        }
+    }
+
+    if (sys::fs::create_directories(CacheDir)) {
+        errs() << "Object cache: cannot create " << CacheDir << "\n";
+        return;
+    }
+
+    // write to a private file first, so concurrent runs never see a partial
+    // object under the final name.
+    std::string TmpPath = Path + "." + std::to_string(sys::Process::getProcessId()) + ".tmp";
+    {
+        std::error_code EC;
+        raw_fd_ostream OS(TmpPath, EC, sys::fs::OF_None);
+        if (EC) {
+            errs() << "Object cache: cannot write " << TmpPath << ": " << EC.message() << "\n";
+            return;
+        }
+        OS << Obj.getBuffer();
+        // a failed write (e.g. a full disk) only costs the cache entry,
+        // and a truncated object must never get the final name
+        OS.close();
+        if (OS.has_error()) {
+            errs() << "Object cache: cannot write " << TmpPath << ": "
+                    << OS.error().message() << "\n";
+            OS.clear_error();
+            sys::fs::remove(TmpPath);
+            return;
+        }
+    }
+
+    if (sys::fs::rename(TmpPath, Path)) {
+        sys::fs::remove(TmpPath);
+    }
+}
@@ -0,0 +1,54 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef DISKOBJECTCACHE_H
+#define	DISKOBJECTCACHE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+using namespace llvm;
+
+/// Keeps compiled objects in a directory between runs. An object is keyed by
+/// the MD5 of the module IR (after optimization) plus a configuration string
+/// describing the target and the optimizer pipeline, so a change in any of
+/// them is a miss.
+
+class DiskObjectCache : public ObjectCache {
+public:
+
+    DiskObjectCache(std::string CacheDir, std::string Config) :
+    CacheDir(std::move(CacheDir)), Config(std::move(Config)) {
+    }
+
+    void notifyObjectCompiled(const Module *M, MemoryBufferRef Obj) override;
+    std::unique_ptr<MemoryBuffer> getObject(const Module *M) override;
+
+private:
+    std::string CacheDir;
+    std::string Config;
+    // path computed in getObject, reused when the object is compiled on a miss
+    std::map<const Module*, std::string> PendingPaths;
+    std::mutex PendingMutex;
+
+    std::string getCachePath(const Module *M);
+};
+
+#endif	/* DISKOBJECTCACHE_H */
+
@@ -24,9 +24,16 @@ void Executor::execute() {
     InitializeNativeTarget();
     InitializeNativeTargetAsmPrinter();
     InitializeNativeTargetAsmParser();
-    TheJIT = ExitOnErr(KaleidoscopeJIT::Create());
-    TheModule->setDataLayout(TheJIT->getDataLayout());
-    ExitOnErr(TheJIT->addModule(std::move(TheModule)));
+    TheJIT = ExitOnErr(KaleidoscopeJIT::Create(Options));
+    if (TheModule) {
+        TheModule->setDataLayout(TheJIT->getDataLayout());
+        Handles.push_back(ExitOnErr(TheJIT->addModule(std::move(TheModule))));
+    }
+    for (auto &TSM : Modules) {
+        TSM.withModuleDo([this](Module & M) {
+            M.setDataLayout(TheJIT->getDataLayout()); });
+        Handles.push_back(ExitOnErr(TheJIT->addModule(std::move(TSM))));
+    }
 
     
     // Search the JIT for the __anon_expr symbol.
@@ -43,6 +50,8 @@ void Executor::execute() {
     auto *FP = (double (*)())(intptr_t) ExprSymbol.getAddress();
     assert(FP && "Failed to codegen function");
     FP();
-    // Delete the anonymous expression module from the JIT.
-    //TheJIT->removeModule(H);
+    // The program is done, free its code.
+    for (auto H : Handles) {
+        ExitOnErr(TheJIT->removeModule(H));
+    }
 }
@@ -18,6 +18,7 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetMachine.h"
+#include <vector>
 #include "JIT.h"
 
 using namespace llvm;
@@ -26,15 +27,24 @@ using namespace llvm::orc;
 class Executor {
 public:
 
-    Executor(LLVMContext* TheContext, std::unique_ptr<Module>&& TheModule) :
-    TheContext(TheContext), TheModule(std::move(TheModule)) {
+    Executor(LLVMContext* TheContext, std::unique_ptr<Module>&& TheModule,
+            JITOptions Options = JITOptions()) :
+    TheContext(TheContext), TheModule(std::move(TheModule)), Options(Options) {
+    }
+
+    // a program made of modules with their own contexts, see ParallelLLVMIRGen
+    Executor(std::vector<ThreadSafeModule>&& Modules, JITOptions Options = JITOptions()) :
+    Modules(std::move(Modules)), TheContext(nullptr), Options(Options) {
     }
 
     void execute();
 private:
     std::unique_ptr<Module> TheModule;
+    std::vector<ThreadSafeModule> Modules;
     LLVMContext* TheContext;
+    JITOptions Options;
     std::unique_ptr<KaleidoscopeJIT> TheJIT;
+    std::vector<KaleidoscopeJIT::ModuleHandle> Handles;
 };
 
 #endif	/* EXECUTOR_H */
@@ -0,0 +1,178 @@
+//    Copyright 2019 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <algorithm>
+#include <set>
+#include <vector>
+#include <llvm/ADT/SCCIterator.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Analysis/BlockFrequencyInfo.h>
+#include <llvm/Analysis/CallGraph.h>
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/Passes/PassBuilder.h>
+#include "FunctionLayout.h"
+
+const char* FunctionLayout::ColdSection = ".text.unlikely";
+
+// functions this many times cooler than the hottest one are cold; static
+// estimates are flatter (a loop is assumed to run about 32 times)
+static const double ProfileColdRatio = 100;
+static const double EstimateColdRatio = 16;
+// calls of a recursive function per call from outside of its recursion
+static const double RecursionFactor = 8;
+
+void FunctionLayout::estimateHeat(Module& M) {
+
+    FunctionAnalysisManager FAM;
+    PassBuilder PB;
+    PB.registerFunctionAnalyses(FAM);
+
+    // calls to defined functions, with the frequency of the call site
+    // relative to the entry of the caller
+    struct Frequencies {
+        std::vector<std::pair<Function*, double>> Calls;
+        double MaxBlock = 1;
+    };
+    std::map<Function*, Frequencies> Info;
+    for (auto &F : M) {
+        if (F.isDeclaration()) {
+            continue;
+        }
+        auto &BFI = FAM.getResult<BlockFrequencyAnalysis>(F);
+        double Entry = BFI.getEntryFreq();
+        Frequencies& FI = Info[&F];
+        for (auto &BB : F) {
+            double Freq = BFI.getBlockFreq(&BB).getFrequency() / Entry;
+            FI.MaxBlock = std::max(FI.MaxBlock, Freq);
+            for (auto &I : BB) {
+                auto *Call = dyn_cast<CallBase>(&I);
+                Function* Callee = Call ? Call->getCalledFunction() : nullptr;
+                if (Callee && !Callee->isDeclaration()) {
+                    FI.Calls.push_back({Callee, Freq});
+                }
+            }
+        }
+    }
+
+    Function* Main = M.getFunction("main");
+    if (Main && Main->isDeclaration()) {
+        Main = nullptr;
+    }
+    std::map<Function*, double> Count;
+    for (auto &F : Info) {
+        Count[F.first] = !Main || F.first == Main ? 1 : 0;
+    }
+
+    // callers come before their callees in the reversed bottom-up order
+    CallGraph CG(M);
+    std::vector<std::pair<std::vector<Function*>, bool>> SCCs;
+    for (auto I = scc_begin(&CG); !I.isAtEnd(); ++I) {
+        std::vector<Function*> SCC;
+        for (CallGraphNode* Node : *I) {
+            if (Node->getFunction() && !Node->getFunction()->isDeclaration()) {
+                SCC.push_back(Node->getFunction());
+            }
+        }
+        SCCs.push_back({std::move(SCC), I.hasCycle()});
+    }
+
+    for (auto SCC = SCCs.rbegin(); SCC != SCCs.rend(); ++SCC) {
+        std::set<Function*> Members(SCC->first.begin(), SCC->first.end());
+        if (SCC->second) {
+            double Total = 0;
+            for (Function* F : SCC->first) {
+                Total += Count[F];
+            }
+            for (Function* F : SCC->first) {
+                Count[F] = Total * RecursionFactor;
+            }
+        }
+        for (Function* F : SCC->first) {
+            for (auto &Call : Info[F].Calls) {
+                if (!Members.count(Call.first)) {
+                    Count[Call.first] += Count[F] * Call.second;
+                }
+            }
+        }
+    }
+
+    for (auto &F : Info) {
+        Heat[F.first->getName().str()] = Count[F.first] * F.second.MaxBlock;
+    }
+}
+
+void FunctionLayout::annotate(Module& M) {
+
+    if (Profile.empty()) {
+        estimateHeat(M);
+    } else {
+        for (auto &F : M) {
+            if (!F.isDeclaration()) {
+                auto Entry = Profile.find(F.getName().str());
+                Heat[F.getName().str()] = Entry != Profile.end() ? Entry->second : 0;
+            }
+        }
+    }
+
+    double ColdRatio = Profile.empty() ? EstimateColdRatio : ProfileColdRatio;
+    double MaxHeat = 0;
+    for (auto &Entry : Heat) {
+        MaxHeat = std::max(MaxHeat, Entry.second);
+    }
+    for (auto &F : M) {
+        // functions marked 'inline' dissolve in their callers anyway
+        if (F.isDeclaration() || F.hasFnAttribute(Attribute::AlwaysInline)) {
+            continue;
+        }
+        if (Heat[F.getName().str()] * ColdRatio < MaxHeat) {
+            F.addFnAttr(Attribute::Cold);
+        }
+    }
+}
+
+void FunctionLayout::arrange(Module& M) {
+
+    // section names are only meaningful to ELF here
+    bool Sections = Triple(M.getTargetTriple()).isOSBinFormatELF();
+    std::vector<Function*> Hot, Cold;
+    for (auto &F : M) {
+        if (F.isDeclaration()) {
+            continue;
+        }
+        if (F.hasFnAttribute(Attribute::Cold)) {
+            if (Sections) {
+                F.setSection(ColdSection);
+            }
+            Cold.push_back(&F);
+        } else {
+            Hot.push_back(&F);
+        }
+    }
+
+    auto heatOf = [this](Function* F) {
+        auto Entry = Heat.find(F->getName().str());
+        return Entry != Heat.end() ? Entry->second : 0.0;
+    };
+    std::stable_sort(Hot.begin(), Hot.end(), [&](Function* A, Function* B) {
+        return heatOf(A) > heatOf(B);
+    });
+
+    // functions are emitted in module order
+    for (auto *Functions : {&Hot, &Cold}) {
+        for (Function* F : *Functions) {
+            M.getFunctionList().splice(M.end(), M.getFunctionList(), F->getIterator());
+        }
+    }
+}
+
@@ -0,0 +1,62 @@
+//    Copyright 2019 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef FUNCTIONLAYOUT_H
+#define	FUNCTIONLAYOUT_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <llvm/IR/Module.h>
+
+using namespace llvm;
+
+/// How much each function ran, by name: calls plus loop iterations, as
+/// counted by the interpreter tier.
+using FunctionCounts = std::map<std::string, uint64_t>;
+
+/// Packs the hot code of a module together. Before optimization, annotate
+/// rates every function and marks the cold ones: the pipeline then
+/// optimizes them for size and moves the paths calling them to the end of
+/// their callers, where the hot/cold splitting pass can outline them. After
+/// optimization, arrange puts the cold functions, outlined parts included,
+/// in a section of their own and sorts the others hottest first, so the hot
+/// code of the module is contiguous.
+///
+/// The heat of a function comes from the profile when there is one.
+/// Otherwise it is estimated: how many times main (or the host, in modules
+/// without main) calls it through the call graph, weighted by the block
+/// frequencies of the call sites, times the frequency of its hottest block.
+
+class FunctionLayout {
+public:
+    // where the cold code goes, the JIT memory manager keeps it apart
+    static const char* ColdSection;
+
+    explicit FunctionLayout(FunctionCounts Profile = FunctionCounts()) :
+    Profile(std::move(Profile)) {
+    }
+
+    void annotate(Module& M);
+    void arrange(Module& M);
+private:
+    FunctionCounts Profile;
+    // by name, the pipeline deletes and creates functions
+    std::map<std::string, double> Heat;
+
+    void estimateHeat(Module& M);
+};
+
+#endif	/* FUNCTIONLAYOUT_H */
+
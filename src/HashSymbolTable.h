@@ -0,0 +1,130 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef HASHSYMBOLTABLE_H
+#define	HASHSYMBOLTABLE_H
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include "Identifier.h"
+#include "Symbol.h"
+
+/// Scoped symbol table with the semantics of ListSymbolTable (a name is
+/// inserted only once, whatever the scope) in O(1) per operation. Names are
+/// interned, so probing compares pointers and never hashes a string.
+///
+/// Symbols live in a deque, in insertion order, indexed by an open addressing
+/// (linear probing) hash table. Scopes are marks in the deque: since symbols
+/// are always removed in the reverse order of their insertion, no later
+/// symbol can have probed past the slot of the one being removed, so popping
+/// a scope just clears its slots, without tombstones or rehashing.
+
+template<typename SSAType>
+class HashSymbolTable {
+public:
+
+    HashSymbolTable() : slots(InitialSlots) {
+    }
+
+    void push_scope() {
+        scopeDeep++;
+        scopeMarks.push_back(symbols.size());
+    }
+
+    void pop_scope() {
+        size_t mark = scopeMarks.empty() ? 0 : scopeMarks.back();
+        while (symbols.size() > mark) {
+            slots[findSlot(symbols.back().getName())].symbol = nullptr;
+            symbols.pop_back();
+        }
+        if (!scopeMarks.empty()) {
+            scopeMarks.pop_back();
+        }
+        scopeDeep--;
+    }
+
+    bool contains(Identifier name) {
+        return getSymbol(name) != nullptr;
+    }
+
+    StorageType getStorageType(Identifier name) {
+        return StorageType::LOCAL;
+    }
+
+    Symbol<SSAType>* getSymbol(Identifier name) {
+        return slots[findSlot(name)].symbol;
+    }
+
+    void insertSymbol(Identifier name, StorageType storageType, SSAType menRef) {
+
+        size_t idx = findSlot(name);
+        if (slots[idx].symbol) {
+            return;
+        }
+
+        symbols.emplace_back(name, menRef, storageType, scopeDeep);
+        slots[idx] = {name, &symbols.back()};
+
+        // keep the load factor under 1/2, probe sequences stay short
+        if (symbols.size() * 2 > slots.size()) {
+            grow();
+        }
+    }
+private:
+
+    struct Slot {
+        Identifier name;
+        Symbol<SSAType>* symbol = nullptr;
+    };
+
+    static const size_t InitialSlots = 64;
+
+    // power of two sized
+    std::vector<Slot> slots;
+    // deque: growing it does not move the symbols the slots point to
+    std::deque<Symbol<SSAType>> symbols;
+    std::vector<size_t> scopeMarks;
+    int scopeDeep = 0;
+
+    // slot holding name, or the empty slot where it would be inserted
+    size_t findSlot(Identifier name) {
+        size_t mask = slots.size() - 1;
+        size_t idx = name.hash() & mask;
+        while (slots[idx].symbol) {
+            if (slots[idx].name == name) {
+                break;
+            }
+            idx = (idx + 1) & mask;
+        }
+        return idx;
+    }
+
+    // reinsert in insertion order, so removal in reverse order stays valid
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2);
+        slots.swap(old);
+        size_t mask = slots.size() - 1;
+        for (auto &symbol : symbols) {
+            size_t idx = symbol.getName().hash() & mask;
+            while (slots[idx].symbol) {
+                idx = (idx + 1) & mask;
+            }
+            slots[idx] = {symbol.getName(), &symbol};
+        }
+    }
+};
+
+#endif	/* HASHSYMBOLTABLE_H */
+
@@ -0,0 +1,73 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <deque>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include "Identifier.h"
+
+// The pool is split in shards by hash, each one with its own lock, so
+// threads lexing different inputs rarely wait for each other.
+
+static const size_t NumShards = 16;
+
+struct PoolShard {
+    std::mutex lock;
+    // keys point into the names of the entries
+    std::unordered_map<std::string_view, const Identifier::Entry*> index;
+    // deque: entries do not move when it grows
+    std::deque<Identifier::Entry> entries;
+};
+
+// function local, so identifiers can be built during static initialization
+static PoolShard* getShards() {
+    static PoolShard shards[NumShards];
+    return shards;
+}
+
+static const Identifier::Entry* intern(std::string_view name) {
+
+    size_t hash = std::hash<std::string_view>()(name);
+    PoolShard& shard = getShards()[hash % NumShards];
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto it = shard.index.find(name);
+    if (it != shard.index.end()) {
+        return it->second;
+    }
+
+    shard.entries.push_back({std::string(name), hash});
+    const Identifier::Entry* entry = &shard.entries.back();
+    shard.index.emplace(std::string_view(entry->name), entry);
+    return entry;
+}
+
+static const Identifier::Entry* emptyEntry() {
+    static const Identifier::Entry* entry = intern(std::string_view());
+    return entry;
+}
+
+Identifier::Identifier() : entry(emptyEntry()) {
+}
+
+Identifier::Identifier(const std::string& name) : entry(intern(name)) {
+}
+
+Identifier::Identifier(const char* name) : entry(intern(name)) {
+}
+
+Identifier::Identifier(const char* name, size_t length) :
+entry(intern(std::string_view(name, length))) {
+}
@@ -0,0 +1,88 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef IDENTIFIER_H
+#define	IDENTIFIER_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+/// Interned name. Equal names share a single entry of a process wide pool, so
+/// copies are a pointer, and comparing or hashing does not touch the string.
+/// Entries are never freed. The pool is thread safe.
+
+class Identifier {
+public:
+
+    // the empty name
+    Identifier();
+
+    explicit Identifier(const std::string& name);
+    explicit Identifier(const char* name);
+    explicit Identifier(const char* name, size_t length);
+
+    const std::string& str() const {
+        return entry->name;
+    }
+
+    bool empty() const {
+        return entry->name.empty();
+    }
+
+    // hash of the string, computed once by the pool
+    size_t hash() const {
+        return entry->hash;
+    }
+
+    bool operator==(const Identifier& other) const {
+        return entry == other.entry;
+    }
+
+    bool operator!=(const Identifier& other) const {
+        return entry != other.entry;
+    }
+
+    // pointer sized handle, for compact storage (see TokenBuffer)
+    const void* getOpaqueValue() const {
+        return entry;
+    }
+
+    static Identifier getFromOpaqueValue(const void* value) {
+        Identifier id;
+        id.entry = static_cast<const Entry*> (value);
+        return id;
+    }
+
+    struct Entry {
+        std::string name;
+        size_t hash;
+    };
+private:
+    const Entry* entry;
+};
+
+namespace std {
+
+    template<>
+    struct hash<Identifier> {
+
+        size_t operator()(const Identifier& id) const {
+            return id.hash();
+        }
+    };
+}
+
+#endif	/* IDENTIFIER_H */
+
@@ -0,0 +1,264 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <llvm/Support/DynamicLibrary.h>
+#include "Interpreter.h"
+
+// slots of the interpreter stack (8MB), shared by all frames
+static const size_t StackSize = 1 << 20;
+
+static void abort(const char *Str, const std::string& name) {
+    fprintf(stderr, "Interpreter fatal: %s (%s)\n", Str, name.c_str());
+    exit(-1);
+}
+
+Interpreter::Interpreter(std::unique_ptr<BytecodeModule> TheModule, uint64_t threshold,
+        std::function<void()> onHot) :
+TheModule(std::move(TheModule)), threshold(threshold), onHot(std::move(onHot)) {
+
+    profiles = std::make_unique<FunctionProfile[]>(this->TheModule->functions.size());
+    stack = std::make_unique<BCSlot[]>(StackSize);
+    stackTop = stack.get();
+    stackEnd = stack.get() + StackSize;
+
+    // externs are resolved in the host process, like the JIT does.
+    llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+}
+
+void Interpreter::installNative(unsigned idx, NativeEntry entry) {
+    profiles[idx].native.store(entry, std::memory_order_release);
+}
+
+std::map<std::string, uint64_t> Interpreter::getProfile() {
+    std::map<std::string, uint64_t> profile;
+    for (unsigned idx = 0; idx < TheModule->functions.size(); idx++) {
+        if (TheModule->functions[idx].defined) {
+            profile[TheModule->functions[idx].name] = profiles[idx].heat;
+        }
+    }
+    return profile;
+}
+
+void Interpreter::tick(FunctionProfile& profile) {
+    if (++profile.heat == threshold) {
+        profile.hot = true;
+        if (onHot) {
+            onHot();
+        }
+    }
+}
+
+// Calls a function, in native code if it is hot and the JIT tier is ready.
+
+BCSlot Interpreter::call(unsigned idx, BCSlot* args) {
+
+    const BCFunction& function = TheModule->functions[idx];
+    if (!function.defined) {
+        return callExtern(idx, args);
+    }
+
+    FunctionProfile& profile = profiles[idx];
+    if (profile.hot) {
+        if (NativeEntry entry = profile.native.load(std::memory_order_acquire)) {
+            BCSlot ret;
+            ret.i = 0;
+            entry(args, &ret);
+            return ret;
+        }
+    }
+
+    tick(profile);
+    return run(idx, args);
+}
+
+#if defined(__x86_64__) && !defined(_WIN32)
+// The System V ABI assigns integer and floating point arguments to separate
+// register files, each one in order. So any extern taking up to 6 integers and
+// 8 reals can be called through these two fixed signatures.
+using IntegerExtern = int64_t(*)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t,
+        double, double, double, double, double, double, double, double);
+using RealExtern = double(*)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t,
+        double, double, double, double, double, double, double, double);
+#endif
+
+BCSlot Interpreter::callExtern(unsigned idx, BCSlot* args) {
+
+    const BCFunction& function = TheModule->functions[idx];
+    FunctionProfile& profile = profiles[idx];
+
+    if (!profile.externAddr) {
+        profile.externAddr =
+                llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(function.name);
+        if (!profile.externAddr) {
+            abort("Unresolved extern function", function.name);
+        }
+    }
+
+    BCSlot ret;
+    ret.i = 0;
+#if defined(__x86_64__) && !defined(_WIN32)
+    int64_t integers[6] = {0};
+    double reals[8] = {0};
+    unsigned numIntegers = 0, numReals = 0;
+    for (unsigned i = 0; i < function.argTypes.size(); i++) {
+        if (function.argTypes[i] == REAL) {
+            if (numReals == 8) {
+                abort("Too many real arguments for an interpreted extern call", function.name);
+            }
+            reals[numReals++] = args[i].r;
+        } else {
+            if (numIntegers == 6) {
+                abort("Too many integer arguments for an interpreted extern call", function.name);
+            }
+            integers[numIntegers++] = args[i].i;
+        }
+    }
+
+    if (function.returnType == REAL) {
+        auto fn = reinterpret_cast<RealExtern> (profile.externAddr);
+        ret.r = fn(integers[0], integers[1], integers[2], integers[3], integers[4],
+                integers[5], reals[0], reals[1], reals[2], reals[3], reals[4], reals[5],
+                reals[6], reals[7]);
+    } else {
+        auto fn = reinterpret_cast<IntegerExtern> (profile.externAddr);
+        ret.i = fn(integers[0], integers[1], integers[2], integers[3], integers[4],
+                integers[5], reals[0], reals[1], reals[2], reals[3], reals[4], reals[5],
+                reals[6], reals[7]);
+    }
+#else
+    abort("Extern calls from the interpreter are not supported on this target",
+            function.name);
+#endif
+    return ret;
+}
+
+// The interpreter loop. Frames are laid out on the shared stack as the
+// function slots followed by its operand stack.
+
+BCSlot Interpreter::run(unsigned idx, BCSlot* args) {
+
+    const BCFunction& function = TheModule->functions[idx];
+    FunctionProfile& profile = profiles[idx];
+    const std::vector<BCFunction>& functions = TheModule->functions;
+
+    BCSlot* locals = stackTop;
+    BCSlot* top = locals + function.slotTypes.size();
+    stackTop = top + function.maxStack;
+    if (stackTop > stackEnd) {
+        abort("Stack overflow", function.name);
+    }
+    std::copy(args, args + function.argTypes.size(), locals);
+
+    const BCInstruction* code = function.code.data();
+    const BCInstruction* pc = code;
+    BCSlot ret;
+    ret.i = 0;
+
+    while (true) {
+        const BCInstruction& inst = *pc++;
+        switch (inst.op) {
+            case OpCode::PushInt:
+            case OpCode::PushReal:
+                *top++ = inst.imm;
+                break;
+            case OpCode::Load:
+                *top++ = locals[inst.a];
+                break;
+            case OpCode::Store:
+                locals[inst.a] = *--top;
+                break;
+            case OpCode::Dup:
+                *top = top[-1];
+                top++;
+                break;
+            case OpCode::Pop:
+                top--;
+                break;
+            // integer arithmetic wraps around, as in the JIT tier
+            case OpCode::AddI:
+                top[-2].i = (int64_t) ((uint64_t) top[-2].i + (uint64_t) top[-1].i);
+                top--;
+                break;
+            case OpCode::AddR:
+                top[-2].r = top[-2].r + top[-1].r;
+                top--;
+                break;
+            case OpCode::SubI:
+                top[-2].i = (int64_t) ((uint64_t) top[-2].i - (uint64_t) top[-1].i);
+                top--;
+                break;
+            case OpCode::SubR:
+                top[-2].r = top[-2].r - top[-1].r;
+                top--;
+                break;
+            case OpCode::MulI:
+                top[-2].i = (int64_t) ((uint64_t) top[-2].i * (uint64_t) top[-1].i);
+                top--;
+                break;
+            case OpCode::MulR:
+                top[-2].r = top[-2].r * top[-1].r;
+                top--;
+                break;
+            case OpCode::EqI:
+                top[-2].i = top[-2].i == top[-1].i;
+                top--;
+                break;
+            // real comparisons are unordered (true for NaN) like fcmp ueq/ult
+            case OpCode::EqR:
+                top[-2].i = !(top[-2].r < top[-1].r) && !(top[-2].r > top[-1].r);
+                top--;
+                break;
+            case OpCode::LtI:
+                top[-2].i = top[-2].i < top[-1].i;
+                top--;
+                break;
+            case OpCode::LtR:
+                top[-2].i = !(top[-2].r >= top[-1].r);
+                top--;
+                break;
+            case OpCode::Jump:
+                pc = code + inst.a;
+                break;
+            case OpCode::JumpIfFalse:
+                if (!(--top)->i) {
+                    pc = code + inst.a;
+                }
+                break;
+            case OpCode::LoopBack:
+                tick(profile);
+                pc = code + inst.a;
+                break;
+            case OpCode::Call:
+            {
+                const BCFunction& callee = functions[inst.a];
+                top -= callee.argTypes.size();
+                BCSlot result = call(inst.a, top);
+                if (callee.returnType != NONE) {
+                    *top++ = result;
+                }
+                break;
+            }
+            case OpCode::Ret:
+                ret = top[-1];
+                stackTop = locals;
+                return ret;
+            case OpCode::RetVoid:
+                stackTop = locals;
+                return ret;
+        }
+    }
+}
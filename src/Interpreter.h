@@ -0,0 +1,73 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef INTERPRETER_H
+#define	INTERPRETER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Bytecode.h"
+
+/// Entry point of a promoted function. Arguments and the return value are
+/// passed as interpreter slots, see TieredExecutor for the generated adapters.
+using NativeEntry = void (*)(BCSlot* args, BCSlot* ret);
+
+/// Tier-1 execution engine. Runs bytecode and counts calls and loop
+/// backedges per function; when a function gets hot the promotion handler is
+/// called, and once native code is installed for it, calls go to the JIT tier.
+
+class Interpreter {
+public:
+    Interpreter(std::unique_ptr<BytecodeModule> TheModule, uint64_t threshold,
+            std::function<void()> onHot);
+
+    BCSlot call(unsigned idx, BCSlot* args);
+    const BytecodeModule& getModule() {
+        return *TheModule;
+    }
+
+    // may be called from the compiler thread
+    void installNative(unsigned idx, NativeEntry entry);
+    // heat of the defined functions so far, by name
+    std::map<std::string, uint64_t> getProfile();
+
+private:
+
+    struct FunctionProfile {
+        uint64_t heat = 0;
+        bool hot = false;
+        std::atomic<NativeEntry> native{nullptr};
+        void* externAddr = nullptr;
+    };
+
+    std::unique_ptr<BytecodeModule> TheModule;
+    std::unique_ptr<FunctionProfile[]> profiles;
+    uint64_t threshold;
+    std::function<void()> onHot;
+    std::unique_ptr<BCSlot[]> stack;
+    BCSlot* stackTop;
+    BCSlot* stackEnd;
+
+    BCSlot run(unsigned idx, BCSlot* args);
+    BCSlot callExtern(unsigned idx, BCSlot* args);
+    void tick(FunctionProfile& profile);
+};
+
+#endif	/* INTERPRETER_H */
+
@@ -13,50 +13,314 @@
 #ifndef LLVM_EXECUTIONENGINE_ORC_KALEIDOSCOPEJIT_H
 #define LLVM_EXECUTIONENGINE_ORC_KALEIDOSCOPEJIT_H
 
+#include "llvm/ADT/EquivalenceClasses.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
+#include "llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
 #include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
 #include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/LazyReexports.h"
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdlib>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "DiskObjectCache.h"
+#include "SlabMemoryManager.h"
 
 namespace llvm {
 namespace orc {
-    
+
+/// Knobs of the JIT, set from the command line.
+struct JITOptions {
+  // Compile each function on its first call, through lazy reexport stubs.
+  bool Lazy = false;
+  // Size of the compile thread pool, 0 compiles on the requesting thread.
+  unsigned CompileThreads = 0;
+  // Directory of the persistent object cache, empty disables the cache.
+  std::string CacheDir;
+  // Describes the IR optimization pipeline, part of the object cache key.
+  std::string PipelineConfig;
+  // Optimization level of the code generator.
+  CodeGenOpt::Level CodeGenLevel = CodeGenOpt::Default;
+  // Target CPU, empty or "native" selects the host CPU and its features.
+  std::string CPU;
+  // Extra target features ("+avx2", "-avx512f"), applied after the CPU ones.
+  std::vector<std::string> Features;
+  // Code model of the generated code, the target default when unset.
+  Optional<CodeModel::Model> TargetCodeModel;
+  // Carve the code and data of all objects from shared slabs, see SlabPool.
+  bool PooledMemory = false;
+  // Back the slabs with huge pages, only with PooledMemory.
+  bool HugePages = false;
+  size_t SlabSize = 4 << 20;
+  // Print the slab occupation when the JIT goes away.
+  bool PrintMemoryStats = false;
+};
+
+/// Memory manager of one object. The linking layer keeps it until the JIT
+/// goes away, but its sections can be released before, when the code of the
+/// object is removed from the JIT.
+class ReleasableMemoryManager : public RuntimeDyld::MemoryManager {
+  std::unique_ptr<RuntimeDyld::MemoryManager> MemMgr;
+
+public:
+  explicit ReleasableMemoryManager(
+      std::unique_ptr<RuntimeDyld::MemoryManager> MemMgr)
+      : MemMgr(std::move(MemMgr)) {}
+
+  uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID,
+                               StringRef SectionName) override {
+    return MemMgr->allocateCodeSection(Size, Alignment, SectionID,
+                                       SectionName);
+  }
+
+  uint8_t *allocateDataSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID, StringRef SectionName,
+                               bool IsReadOnly) override {
+    return MemMgr->allocateDataSection(Size, Alignment, SectionID, SectionName,
+                                       IsReadOnly);
+  }
+
+  void notifyObjectLoaded(RuntimeDyld &RTDyld,
+                          const object::ObjectFile &Obj) override {
+    MemMgr->notifyObjectLoaded(RTDyld, Obj);
+  }
+
+  void registerEHFrames(uint8_t *Addr, uint64_t LoadAddr,
+                        size_t Size) override {
+    MemMgr->registerEHFrames(Addr, LoadAddr, Size);
+  }
+
+  void deregisterEHFrames() override {
+    if (MemMgr)
+      MemMgr->deregisterEHFrames();
+  }
+
+  bool finalizeMemory(std::string *ErrMsg = nullptr) override {
+    return MemMgr->finalizeMemory(ErrMsg);
+  }
+
+  /// Unmaps the sections, the object must not be used anymore.
+  void release() {
+    if (!MemMgr)
+      return;
+    MemMgr->deregisterEHFrames();
+    MemMgr.reset();
+  }
+};
+
+/// Linking layer that tells which module each object comes from. emit
+/// creates the memory manager of the object on the calling thread, so the
+/// memory manager creator can ask for it.
+class TrackingObjectLinkingLayer : public RTDyldObjectLinkingLayer {
+public:
+  using RTDyldObjectLinkingLayer::RTDyldObjectLinkingLayer;
+
+  void emit(MaterializationResponsibility R,
+            std::unique_ptr<MemoryBuffer> O) override {
+    emittingModule() = R.getVModuleKey();
+    RTDyldObjectLinkingLayer::emit(std::move(R), std::move(O));
+  }
+
+  static VModuleKey &emittingModule() {
+    static thread_local VModuleKey K = 0;
+    return K;
+  }
+};
+
 class KaleidoscopeJIT {
 private:
   ExecutionSession ES;
-  RTDyldObjectLinkingLayer ObjectLayer;
+  // Shared by the memory managers of all objects when the JIT memory is
+  // pooled, so it must outlive the linking layer.
+  std::unique_ptr<SlabPool> MemoryPool;
+  bool PrintMemoryStats;
+  TrackingObjectLinkingLayer ObjectLayer;
+  std::unique_ptr<ObjectCache> ObjCache;
   IRCompileLayer CompileLayer;
 
   DataLayout DL;
+  Triple TT;
   MangleAndInterner Mangle;
   ThreadSafeContext Ctx;
 
   JITDylib &MainJD;
 
+  // What each module holds, for removeModule.
+  struct ModuleResources {
+    JITDylib *JD = nullptr;
+    SymbolNameSet Symbols;
+    std::vector<ReleasableMemoryManager *> Memory;
+  };
+  std::mutex ResourcesLock;
+  std::map<VModuleKey, ModuleResources> Resources;
+
+  // Only used in lazy mode: CODLayer splits modules per function and emits a
+  // stub for each one, the stub compiles the function on its first call.
+  std::unique_ptr<LazyCallThroughManager> LCTMgr;
+  std::unique_ptr<CompileOnDemandLayer> CODLayer;
+
+  // Materialization is dispatched to this pool when it exists. Declared after
+  // the layers so it is drained before they go away.
+  std::unique_ptr<ThreadPool> CompileThreads;
+  unsigned NumCompileThreads;
+
+  static std::unique_ptr<ObjectCache>
+  createObjectCache(const JITTargetMachineBuilder &JTMB,
+                    const JITOptions &Options) {
+    if (Options.CacheDir.empty())
+      return nullptr;
+    // anything that changes the generated code must be part of the key
+    std::string Config = JTMB.getTargetTriple().str() + ";" + JTMB.getCPU() +
+                         ";" + JTMB.getFeatures().getString() + ";" +
+                         std::to_string(Options.CodeGenLevel) + ";" +
+                         (Options.TargetCodeModel
+                              ? std::to_string(*Options.TargetCodeModel)
+                              : std::string("default")) +
+                         ";" + Options.PipelineConfig;
+    return std::make_unique<DiskObjectCache>(Options.CacheDir, Config);
+  }
+
+  static std::unique_ptr<SlabPool> createMemoryPool(const JITOptions &Options) {
+    if (!Options.PooledMemory)
+      return nullptr;
+    auto Pool = SlabPool::Create(Options.SlabSize, Options.HugePages);
+    if (!Pool) {
+      errs() << "JIT warning: " << toString(Pool.takeError())
+             << ", JIT memory is not pooled\n";
+      return nullptr;
+    }
+    return std::move(*Pool);
+  }
+
+  std::unique_ptr<RuntimeDyld::MemoryManager> createMemoryManager() {
+    std::unique_ptr<RuntimeDyld::MemoryManager> Sections;
+    if (MemoryPool)
+      Sections = std::make_unique<SlabMemoryManager>(*MemoryPool);
+    else
+      Sections = std::make_unique<SectionMemoryManager>();
+    auto MemMgr = std::make_unique<ReleasableMemoryManager>(std::move(Sections));
+    std::lock_guard<std::mutex> Lock(ResourcesLock);
+    auto R = Resources.find(TrackingObjectLinkingLayer::emittingModule());
+    // a module removed before it was emitted leaks its memory
+    if (R != Resources.end())
+      R->second.Memory.push_back(MemMgr.get());
+    return MemMgr;
+  }
+
+  VModuleKey addResources(JITDylib &JD, SymbolNameSet Symbols) {
+    VModuleKey K = ES.allocateVModule();
+    std::lock_guard<std::mutex> Lock(ResourcesLock);
+    auto &R = Resources[K];
+    R.JD = &JD;
+    R.Symbols = std::move(Symbols);
+    return K;
+  }
+
+  static void handleLazyCompileFailure() {
+    errs() << "JIT error: lazy compilation of a function failed\n";
+    exit(-1);
+  }
+
 public:
-  KaleidoscopeJIT(JITTargetMachineBuilder JTMB, DataLayout DL)
-      : ObjectLayer(ES,
-                    []() { return std::make_unique<SectionMemoryManager>(); }),
+  KaleidoscopeJIT(JITTargetMachineBuilder JTMB, DataLayout DL,
+                  const JITOptions &Options)
+      : MemoryPool(createMemoryPool(Options)),
+        PrintMemoryStats(Options.PrintMemoryStats),
+        ObjectLayer(ES, [this]() { return createMemoryManager(); }),
+        ObjCache(createObjectCache(JTMB, Options)),
         CompileLayer(ES, ObjectLayer,
-                     std::make_unique<ConcurrentIRCompiler>(std::move(JTMB))),
-        DL(std::move(DL)), Mangle(ES, this->DL),
+                     std::make_unique<ConcurrentIRCompiler>(JTMB,
+                                                            ObjCache.get())),
+        DL(std::move(DL)), TT(JTMB.getTargetTriple()), Mangle(ES, this->DL),
         Ctx(std::make_unique<LLVMContext>()),
-        MainJD(ES.createBareJITDylib("<main>")) {
+        MainJD(ES.createBareJITDylib("<main>")),
+        NumCompileThreads(Options.CompileThreads) {
     MainJD.addGenerator(
         cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(
             DL.getGlobalPrefix())));
+
+    if (NumCompileThreads > 0) {
+      CompileThreads =
+          std::make_unique<ThreadPool>(hardware_concurrency(NumCompileThreads));
+      ES.setDispatchMaterialization(
+          [this](std::unique_ptr<MaterializationUnit> MU,
+                 MaterializationResponsibility MR) {
+            // ThreadPool tasks must be copyable.
+            auto SharedMU = std::shared_ptr<MaterializationUnit>(std::move(MU));
+            auto SharedMR =
+                std::make_shared<MaterializationResponsibility>(std::move(MR));
+            CompileThreads->async([SharedMU, SharedMR]() {
+              SharedMU->materialize(std::move(*SharedMR));
+            });
+          });
+      // Lazy partitions share the context of their module, give each one a
+      // fresh context so they can be compiled at the same time.
+      if (Options.Lazy)
+        CompileLayer.setCloneToNewContextOnEmit(true);
+    }
+
+    if (Options.Lazy) {
+      LCTMgr = cantFail(createLocalLazyCallThroughManager(
+          TT, ES, pointerToJITTargetAddress(&handleLazyCompileFailure)));
+      CODLayer = std::make_unique<CompileOnDemandLayer>(
+          ES, CompileLayer, *LCTMgr, createLocalIndirectStubsManagerBuilder(TT));
+      CODLayer->setPartitionFunction(CompileOnDemandLayer::compileRequested);
+    }
   }
 
-  static Expected<std::unique_ptr<KaleidoscopeJIT>> Create() {
+  ~KaleidoscopeJIT() {
+    if (PrintMemoryStats && MemoryPool)
+      MemoryPool->printStats(errs());
+  }
+
+  /// Target of the generated code for Options. Also used to build the
+  /// TargetMachine the optimizer queries for costs and vector widths.
+  static Expected<JITTargetMachineBuilder>
+  createTargetMachineBuilder(const JITOptions &Options = JITOptions()) {
     auto JTMB = JITTargetMachineBuilder::detectHost();
+    if (!JTMB)
+      return JTMB.takeError();
+
+    JTMB->getFeatures() = SubtargetFeatures();
+    if (Options.CPU.empty() || Options.CPU == "native") {
+      JTMB->setCPU(std::string(sys::getHostCPUName()));
+      StringMap<bool> HostFeatures;
+      if (sys::getHostCPUFeatures(HostFeatures))
+        for (auto &Feature : HostFeatures)
+          JTMB->getFeatures().AddFeature(Feature.first(), Feature.second);
+    } else {
+      JTMB->setCPU(Options.CPU);
+    }
+    for (auto &Feature : Options.Features)
+      JTMB->getFeatures().AddFeature(Feature);
+
+    if (Options.TargetCodeModel)
+      JTMB->setCodeModel(Options.TargetCodeModel);
+    JTMB->setCodeGenOptLevel(Options.CodeGenLevel);
+    return JTMB;
+  }
+
+  static Expected<std::unique_ptr<KaleidoscopeJIT>>
+  Create(const JITOptions &Options = JITOptions()) {
+    auto JTMB = createTargetMachineBuilder(Options);
 
     if (!JTMB)
       return JTMB.takeError();
@@ -65,19 +329,216 @@ public:
     if (!DL)
       return DL.takeError();
 
-    return std::make_unique<KaleidoscopeJIT>(std::move(*JTMB), std::move(*DL));
+    return std::make_unique<KaleidoscopeJIT>(std::move(*JTMB), std::move(*DL),
+                                             Options);
   }
 
   const DataLayout &getDataLayout() const { return DL; }
 
   LLVMContext &getContext() { return *Ctx.getContext(); }
 
-  Error addModule(std::unique_ptr<Module> M) {
-    return CompileLayer.add(MainJD, ThreadSafeModule(std::move(M), Ctx));
+  const Triple &getTargetTriple() const { return TT; }
+
+  /// The pool of the JIT memory, null unless it is pooled.
+  SlabPool *getMemoryPool() { return MemoryPool.get(); }
+
+  /// Identifies a module added to the JIT, see removeModule.
+  using ModuleHandle = VModuleKey;
+
+  Expected<ModuleHandle> addModule(std::unique_ptr<Module> M) {
+    return addModule(ThreadSafeModule(std::move(M), Ctx));
+  }
+
+  /// Adds a module that comes with its own context, e.g. one of the modules
+  /// generated in parallel. Modules added to the JIT link against each other.
+  Expected<ModuleHandle> addModule(ThreadSafeModule TSM) {
+    return addModule(std::move(TSM), MainJD);
+  }
+
+  Expected<ModuleHandle> addModule(ThreadSafeModule TSM, JITDylib &JD) {
+    SymbolNameSet Names;
+    TSM.withModuleDo([&](Module &M) {
+      for (auto &GV : M.global_values())
+        if (!GV.isDeclaration() && !GV.hasLocalLinkage())
+          Names.insert(Mangle(GV.getName()));
+    });
+    ModuleHandle H = addResources(JD, std::move(Names));
+    if (auto Err = addToLayers(std::move(TSM), JD, H))
+      return std::move(Err);
+    return H;
+  }
+
+  /// Removes the symbols of the module and unmaps its code and data once
+  /// emitted. Nothing may run or point into that code anymore. In lazy mode
+  /// the stubs of its functions stay behind.
+  Error removeModule(ModuleHandle H) {
+    ModuleResources R;
+    {
+      std::lock_guard<std::mutex> Lock(ResourcesLock);
+      auto I = Resources.find(H);
+      if (I == Resources.end())
+        return make_error<StringError>("Unknown module",
+                                       inconvertibleErrorCode());
+      R = std::move(I->second);
+      Resources.erase(I);
+    }
+    if (!R.Symbols.empty())
+      if (auto Err = R.JD->remove(R.Symbols))
+        return Err;
+    for (auto *MemMgr : R.Memory)
+      MemMgr->release();
+    return Error::success();
+  }
+
+private:
+  Error addToLayers(ThreadSafeModule TSM, JITDylib &JD, VModuleKey K) {
+    if (CODLayer)
+      return CODLayer->add(JD, std::move(TSM), K);
+    if (!CompileThreads)
+      return CompileLayer.add(JD, std::move(TSM), K);
+
+    // Eager parallel mode: add one partition per compile thread, then ask for
+    // every definition at once so all partitions are dispatched to the pool.
+    SymbolLookupSet Defined;
+    TSM.withModuleDo([&](Module &M) {
+      for (auto &GV : M.global_values())
+        if (!GV.isDeclaration() && !GV.hasLocalLinkage())
+          Defined.add(Mangle(GV.getName()));
+    });
+    for (auto &Part : splitModule(TSM, NumCompileThreads))
+      if (auto Err = CompileLayer.add(JD, std::move(Part), K))
+        return Err;
+    return ES.lookup(makeJITDylibSearchOrder({&JD}), std::move(Defined))
+        .takeError();
+  }
+
+public:
+
+  /// The definitions (functions or global initializers) that refer to V,
+  /// looking through constant expressions.
+  static std::vector<const GlobalValue *> definitionsUsing(const Value &V) {
+    std::vector<const GlobalValue *> Result;
+    for (auto *U : V.users()) {
+      if (auto *I = dyn_cast<Instruction>(U))
+        Result.push_back(I->getFunction());
+      else if (auto *GV = dyn_cast<GlobalValue>(U))
+        Result.push_back(GV);
+      else if (isa<Constant>(U))
+        for (auto *Def : definitionsUsing(*U))
+          Result.push_back(Def);
+    }
+    return Result;
+  }
+
+  /// Split TSM in up to Parts modules, each one in its own context. A symbol
+  /// with local linkage must stay with its users, since other partitions
+  /// cannot refer to it, so the definitions are first grouped into clusters
+  /// (e.g. a function and the *.cold.N parts split out of it). Clusters are
+  /// assigned largest first to the lightest partition.
+  static std::vector<ThreadSafeModule> splitModule(ThreadSafeModule &TSM,
+                                                   unsigned Parts) {
+    std::vector<std::set<const GlobalValue *>> Partitions;
+    TSM.withModuleDo([&](Module &M) {
+      EquivalenceClasses<const GlobalValue *> Clusters;
+      for (auto &GV : M.global_values())
+        if (!GV.isDeclaration())
+          Clusters.insert(&GV);
+      for (auto &GV : M.global_values())
+        if (!GV.isDeclaration() && GV.hasLocalLinkage())
+          for (auto *User : definitionsUsing(GV))
+            Clusters.unionSets(&GV, User);
+
+      std::vector<std::pair<unsigned, std::vector<const GlobalValue *>>> Defs;
+      for (auto I = Clusters.begin(); I != Clusters.end(); ++I) {
+        if (!I->isLeader())
+          continue;
+        Defs.emplace_back();
+        for (auto Member = Clusters.member_begin(I); Member != Clusters.member_end();
+             ++Member) {
+          if (auto *F = dyn_cast<Function>(*Member))
+            Defs.back().first += F->getInstructionCount();
+          Defs.back().second.push_back(*Member);
+        }
+      }
+      llvm::stable_sort(Defs, [](const auto &A, const auto &B) {
+        return A.first > B.first;
+      });
+
+      Partitions.resize(std::min<size_t>(Parts, Defs.size()));
+      std::vector<unsigned> Load(Partitions.size(), 0);
+      for (auto &Cluster : Defs) {
+        auto Lightest = std::min_element(Load.begin(), Load.end()) - Load.begin();
+        Load[Lightest] += Cluster.first;
+        Partitions[Lightest].insert(Cluster.second.begin(), Cluster.second.end());
+      }
+    });
+
+    std::vector<ThreadSafeModule> Result;
+    for (auto &P : Partitions)
+      Result.push_back(cloneToNewContext(
+          TSM, [&](const GlobalValue &GV) { return P.count(&GV) != 0; }));
+    return Result;
   }
 
   Expected<JITEvaluatedSymbol> lookup(StringRef Name) {
-    return ES.lookup({&MainJD}, Mangle(Name.str()));
+    return lookup(MainJD, Name);
+  }
+
+  Expected<JITEvaluatedSymbol> lookup(JITDylib &JD, StringRef Name) {
+    return ES.lookup({&JD}, Mangle(Name.str()));
+  }
+
+  /// A new dylib, for code that must not see the symbols of the main one
+  /// (e.g. independent programs). It also resolves the process symbols.
+  JITDylib &createJITDylib(StringRef Name) {
+    JITDylib &JD = ES.createBareJITDylib(Name.str());
+    JD.addGenerator(
+        cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(
+            DL.getGlobalPrefix())));
+    return JD;
+  }
+
+  /// Defines Name at a fixed address, e.g. the stub of a function that can
+  /// be redefined.
+  Error define(StringRef Name, JITTargetAddress Addr) {
+    return define(MainJD, Name, Addr);
+  }
+
+  Error define(JITDylib &JD, StringRef Name, JITTargetAddress Addr) {
+    addResources(JD, {Mangle(Name.str())});
+    return JD.define(absoluteSymbols(
+        {{Mangle(Name.str()),
+          JITEvaluatedSymbol(Addr, JITSymbolFlags::Exported |
+                                       JITSymbolFlags::Callable)}}));
+  }
+
+  /// Drops Name from the symbol table. Its code stays in memory, callers
+  /// that already resolved it keep working.
+  Error remove(StringRef Name) {
+    auto Symbol = Mangle(Name.str());
+    {
+      std::lock_guard<std::mutex> Lock(ResourcesLock);
+      for (auto &R : Resources)
+        if (R.second.JD == &MainJD)
+          R.second.Symbols.erase(Symbol);
+    }
+    return MainJD.remove({Symbol});
+  }
+
+  /// Removes every module of JD, see removeModule. The dylib itself stays in
+  /// the session, empty, and can be reused.
+  Error clearJITDylib(JITDylib &JD) {
+    std::vector<ModuleHandle> Modules;
+    {
+      std::lock_guard<std::mutex> Lock(ResourcesLock);
+      for (auto &R : Resources)
+        if (R.second.JD == &JD)
+          Modules.push_back(R.first);
+    }
+    Error Err = Error::success();
+    for (auto H : Modules)
+      Err = joinErrors(std::move(Err), removeModule(H));
+    return Err;
   }
 };
 
@@ -0,0 +1,241 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <iostream>
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TargetSelect.h"
+#include "JIT.h"
+#include "JITCompiler.h"
+#include "LLVMIRGen.h"
+#include "Lexer.h"
+#include "Optimizer.h"
+#include "Parser.h"
+#include "Runtime.h"
+#include "SourceManager.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+static const char* getTypeName(VarType type) {
+    switch (type) {
+        case REAL:
+            return "real";
+        case INTEGER:
+            return "integer";
+        default:
+            return "none";
+    }
+}
+
+static std::string describe(const std::vector<VarType>& types) {
+    std::string str = getTypeName(types[0]);
+    str += "(";
+    for (size_t i = 1; i < types.size(); i++) {
+        str += i > 1 ? ", " : "";
+        str += getTypeName(types[i]);
+    }
+    return str + ")";
+}
+
+CompiledProgram::~CompiledProgram() {
+    if (JD) {
+        if (auto Err = TheJIT->clearJITDylib(*JD)) {
+            logAllUnhandledErrors(std::move(Err), errs(), "JIT error: ");
+        }
+    }
+}
+
+// On x86-64 and the other supported targets, a function returning a value
+// can be called as one returning nothing.
+
+CompiledProgram::EntryPoint CompiledProgram::getMain(std::string& error) const {
+    auto function = functions.find("main");
+    if (function == functions.end() || function->second.types.size() != 1) {
+        error = "Main function not found";
+        return nullptr;
+    }
+    return reinterpret_cast<EntryPoint> (static_cast<uintptr_t> (function->second.address));
+}
+
+std::vector<std::string> CompiledProgram::getFunctionNames() const {
+    std::vector<std::string> names;
+    for (auto &entry : functions) {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
+uint64_t CompiledProgram::lookupChecked(const std::string& name,
+        const std::vector<VarType>& types, std::string& error) const {
+
+    auto function = functions.find(name);
+    if (function == functions.end()) {
+        error = "Function not found: " + name;
+        return 0;
+    }
+    if (function->second.types != types) {
+        error = "Function " + name + " is " + describe(function->second.types)
+                + ", not " + describe(types);
+        return 0;
+    }
+    return function->second.address;
+}
+
+static JITOptions getJITOptions(const JITCompilerOptions& Options) {
+    JITOptions JITOpts;
+    JITOpts.CacheDir = Options.CacheDir;
+    JITOpts.CPU = Options.CPU;
+    JITOpts.Features = Options.Features;
+    JITOpts.PooledMemory = Options.PooledMemory;
+    JITOpts.HugePages = Options.HugePages;
+    JITOpts.PipelineConfig = Optimizer::getPipelineDescription(Options.OptLevel,
+            Options.LayoutFunctions);
+    JITOpts.CodeGenLevel = Optimizer::getCodeGenLevel(Options.OptLevel);
+    return JITOpts;
+}
+
+Expected<std::unique_ptr<JITCompiler>> JITCompiler::Create(JITCompilerOptions Options) {
+
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+    InitializeNativeTargetAsmParser();
+    auto TheJIT = KaleidoscopeJIT::Create(getJITOptions(Options));
+    if (!TheJIT) {
+        return TheJIT.takeError();
+    }
+    return std::unique_ptr<JITCompiler>(new JITCompiler(std::move(Options), std::move(*TheJIT)));
+}
+
+JITCompiler::JITCompiler(JITCompilerOptions Options, std::unique_ptr<KaleidoscopeJIT> TheJIT) :
+Options(std::move(Options)), TheJIT(std::move(TheJIT)) {
+}
+
+JITCompiler::~JITCompiler() {
+}
+
+// The runtime is defined in every program: the host executable does not
+// necessarily export it to the process symbol search.
+
+Expected<JITDylib&> JITCompiler::createProgramDylib() {
+
+    unsigned number;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        number = ++programs;
+    }
+    JITDylib& JD = TheJIT->createJITDylib("<program " + std::to_string(number) + ">");
+    Error Err = TheJIT->define(JD, "putchard", pointerToJITTargetAddress(&putchard));
+    if (!Err) {
+        Err = TheJIT->define(JD, "printreal", pointerToJITTargetAddress(&printreal));
+    }
+    if (!Err) {
+        Err = TheJIT->define(JD, "printinteger", pointerToJITTargetAddress(&printinteger));
+    }
+    if (Err) {
+        consumeError(TheJIT->clearJITDylib(JD));
+        return std::move(Err);
+    }
+    return JD;
+}
+
+std::unique_ptr<CompiledProgram> JITCompiler::compile(const std::string& source,
+        const std::string& name, std::string& error) {
+
+    unsigned FileID = SourceManager::get().addBuffer(
+            MemoryBuffer::getMemBufferCopy(source, name), name);
+    // only needed while parsing and generating code
+    ScopedSourceBuffer buffer(FileID);
+
+    auto context = std::make_unique<LLVMContext>();
+    LLVMIRGen<> generator(context.get());
+    Parser<LLVMValue> parser(std::make_unique<Lexer>(FileID));
+    while (true) {
+        auto exp = parser.nextConstruct();
+        if (parser.hasFail()) {
+            error = "Syntax errors in " + name;
+            return nullptr;
+        }
+        if (!exp) {
+            break;
+        }
+        generator.GenFromAST(std::move(exp));
+    }
+    if (generator.hasFail()) {
+        error = "Semantic errors in " + name;
+        return nullptr;
+    }
+
+    std::unique_ptr<Module> module = generator.getModule();
+    module->setModuleIdentifier(name);
+
+    auto program = std::make_unique<CompiledProgram>();
+    for (auto &F : *module) {
+        if (F.isDeclaration()) {
+            continue;
+        }
+        FunctionSignature signature = getFunctionSignature(F);
+        CompiledProgram::Function function{{signature.returnType}, 0};
+        for (auto &arg : signature.args) {
+            function.types.push_back(arg.getType());
+        }
+        program->functions.emplace(F.getName().str(), std::move(function));
+    }
+
+    // one target machine per compilation, they are not thread safe
+    auto JTMB = KaleidoscopeJIT::createTargetMachineBuilder(getJITOptions(Options));
+    if (!JTMB) {
+        error = toString(JTMB.takeError());
+        return nullptr;
+    }
+    auto TM = JTMB->createTargetMachine();
+    if (!TM) {
+        error = toString(TM.takeError());
+        return nullptr;
+    }
+    Optimizer optimizer(context.get(), std::move(module), Options.OptLevel, TM->get());
+    if (Options.LayoutFunctions) {
+        optimizer.enableFunctionLayout();
+    }
+    optimizer.optimizeCode();
+
+    auto ProgramJD = createProgramDylib();
+    if (!ProgramJD) {
+        error = toString(ProgramJD.takeError());
+        return nullptr;
+    }
+    JITDylib& JD = *ProgramJD;
+    auto Handle = TheJIT->addModule(ThreadSafeModule(optimizer.getModule(), std::move(context)), JD);
+    if (!Handle) {
+        error = toString(Handle.takeError());
+        // best effort, symbols that failed to materialize cannot be removed
+        consumeError(TheJIT->clearJITDylib(JD));
+        return nullptr;
+    }
+
+    // resolved now, so calls never go through the JIT
+    for (auto &entry : program->functions) {
+        auto Symbol = TheJIT->lookup(JD, entry.first);
+        if (!Symbol) {
+            error = toString(Symbol.takeError());
+            consumeError(TheJIT->clearJITDylib(JD));
+            return nullptr;
+        }
+        entry.second.address = Symbol->getAddress();
+    }
+    program->TheJIT = TheJIT.get();
+    program->JD = &JD;
+    return program;
+}
+
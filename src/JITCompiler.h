@@ -0,0 +1,165 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef JITCOMPILER_H
+#define	JITCOMPILER_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "llvm/Support/Error.h"
+#include "LangDefs.h"
+#include "Runtime.h"
+
+namespace llvm {
+namespace orc {
+class KaleidoscopeJIT;
+class JITDylib;
+}
+}
+
+/// Embedding API: source text is compiled once into a CompiledProgram, whose
+/// functions are then called from the host through plain function pointers.
+///
+///     auto compiler = llvm::cantFail(JITCompiler::Create());
+///     std::string error;
+///     auto program = compiler->compile(source, "kernels", error);
+///     auto *fn = program->lookup<double(int64_t, double)>("kernel", error);
+///     double r = fn(3, 0.5);
+///
+/// integer maps to int64_t, real to double and none to void.
+///
+/// Compiled functions can be called from any number of threads at once. To
+/// keep the output of each execution apart, run it under its own sink:
+///
+///     StringOutputSink out;
+///     {
+///         OutputSinkScope scope(out);
+///         fn(3, 0.5);
+///     }
+
+struct JITCompilerOptions {
+    // IR optimization level, 0 to 3
+    unsigned OptLevel = 2;
+    // Target CPU, empty or "native" selects the host CPU and its features.
+    std::string CPU;
+    // Extra target features ("+avx2", "-avx512f"), applied after the CPU ones.
+    std::vector<std::string> Features;
+    // Directory of the persistent object cache, empty disables the cache.
+    std::string CacheDir;
+    // Pack the code of all programs in shared slabs, see SlabPool.
+    bool PooledMemory = false;
+    bool HugePages = false;
+    // Pack hot functions together, on static estimates, see FunctionLayout.
+    bool LayoutFunctions = false;
+};
+
+template<typename T> struct LangType;
+
+template<> struct LangType<int64_t> {
+    static const VarType type = INTEGER;
+};
+
+template<> struct LangType<double> {
+    static const VarType type = REAL;
+};
+
+template<> struct LangType<void> {
+    static const VarType type = NONE;
+};
+
+template<typename Signature> struct SignatureTypes;
+
+// return type first, then the arguments
+template<typename Ret, typename... Args> struct SignatureTypes<Ret(Args...)> {
+    static std::vector<VarType> get() {
+        return {LangType<Ret>::type, LangType<Args>::type...};
+    }
+};
+
+/// The functions of one compiled source, resolved to native code. The code
+/// lives in the JIT of the compiler that built it, so a program must not
+/// outlive its compiler; it is unmapped when the program is destroyed. The
+/// program is immutable once compiled, so lookups and calls need no locking.
+
+class CompiledProgram {
+public:
+    using EntryPoint = void (*)();
+
+    ~CompiledProgram();
+
+    // nullptr if there is no such function or its signature is not this one
+    template<typename Signature>
+    Signature* lookup(const std::string& name, std::string& error) const {
+        uint64_t address = lookupChecked(name, SignatureTypes<Signature>::get(), error);
+        return reinterpret_cast<Signature*> (static_cast<uintptr_t> (address));
+    }
+
+    // main, whatever it returns: it is called for its effects
+    EntryPoint getMain(std::string& error) const;
+
+    std::vector<std::string> getFunctionNames() const;
+
+private:
+    friend class JITCompiler;
+
+    struct Function {
+        // return type first, then the arguments
+        std::vector<VarType> types;
+        uint64_t address;
+    };
+
+    std::unordered_map<std::string, Function> functions;
+    llvm::orc::KaleidoscopeJIT* TheJIT = nullptr;
+    llvm::orc::JITDylib* JD = nullptr;
+
+    uint64_t lookupChecked(const std::string& name, const std::vector<VarType>& types,
+            std::string& error) const;
+};
+
+/// Compiles programs into a JIT that lives as long as the compiler. Each
+/// program gets its own symbol table, so programs can define the same names.
+/// compile can be called from several threads at once.
+///
+/// Syntax and semantic errors are reported through error, the diagnostics
+/// themselves are printed as in the command line tool. Nothing exits the
+/// host: failures to set up the JIT or the target come back as errors too.
+
+class JITCompiler {
+public:
+    static llvm::Expected<std::unique_ptr<JITCompiler>>
+    Create(JITCompilerOptions Options = JITCompilerOptions());
+    ~JITCompiler();
+
+    // nullptr on failure, with the reason in error
+    std::unique_ptr<CompiledProgram> compile(const std::string& source,
+            const std::string& name, std::string& error);
+
+private:
+    JITCompilerOptions Options;
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> TheJIT;
+    // numbers the program dylibs, their names must be unique
+    std::mutex lock;
+    unsigned programs = 0;
+
+    JITCompiler(JITCompilerOptions Options, std::unique_ptr<llvm::orc::KaleidoscopeJIT> TheJIT);
+
+    llvm::Expected<llvm::orc::JITDylib&> createProgramDylib();
+};
+
+#endif	/* JITCOMPILER_H */
+
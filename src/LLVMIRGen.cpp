@@ -43,20 +43,13 @@
 
 using namespace llvm;
 
-static void abort(const char *Str, std::string loc) {
-    printf("Code generator fatal: %s -> %s\n", Str, loc.c_str());
-    exit(-1);
-}
-
-static void abort(const char *Str, std::string msg, std::string loc) {
-    printf("Code generator fatal: %s (%s) -> %s\n", Str, msg.c_str(), loc.c_str());
-    exit(-1);
-}
-
 static void LogError(const char *Str, std::string loc) {
     fprintf(stderr, "Compiler error (code generator): %s -> %s\n", Str, loc.c_str());
 }
 
+// local holding the return value of the current function
+static const Identifier RetValueName("retvalue");
+
 static Type* convertType(VarType t, LLVMContext* context) {
 
     switch (t) {
@@ -75,7 +68,27 @@ static Type* convertType(VarType t, LLVMContext* context) {
     return nullptr;
 }
 
-LLVMIRGen::LLVMIRGen(llvm::LLVMContext* TheContext) : AbstractIRGen<LLVMValue>() {
+static VarType convertType(Type* type) {
+    if (type->isDoubleTy()) {
+        return REAL;
+    } else if (type->isIntegerTy()) {
+        return INTEGER;
+    }
+    return NONE;
+}
+
+FunctionSignature getFunctionSignature(Function& F) {
+    FunctionSignature signature{Identifier(F.getName().data(), F.getName().size()),
+        convertType(F.getReturnType()), {}};
+    for (auto &A : F.args()) {
+        signature.args.push_back(Arg(Identifier(A.getName().data(), A.getName().size()),
+                convertType(A.getType())));
+    }
+    return signature;
+}
+
+template<template<typename> class SymbolTable>
+LLVMIRGen<SymbolTable>::LLVMIRGen(llvm::LLVMContext* TheContext) : AbstractIRGen<LLVMValue>() {
 
     this->TheContext = TheContext;
     //Builder = std::make_unique<IRBuilder<>>(IRBuilder<>(*TheContext));
@@ -85,20 +98,47 @@ LLVMIRGen::LLVMIRGen(llvm::LLVMContext* TheContext) : AbstractIRGen<LLVMValue>()
     //TheFPM = 
 }
 
+// Semantic errors are reported and recorded, the caller checks hasFail.
+// Only the first one is reported, nothing is generated after it.
+
+template<template<typename> class SymbolTable>
+void LLVMIRGen<SymbolTable>::fail(const char *Str, std::string loc) {
+    if (failed) {
+        return;
+    }
+    printf("Code generator error: %s -> %s\n", Str, loc.c_str());
+    failed = true;
+}
+
+template<template<typename> class SymbolTable>
+void LLVMIRGen<SymbolTable>::fail(const char *Str, std::string msg, std::string loc) {
+    if (failed) {
+        return;
+    }
+    printf("Code generator error: %s (%s) -> %s\n", Str, msg.c_str(), loc.c_str());
+    failed = true;
+}
+
 // Entry point of the IR Generator. Using a visitor design pattern.
 
-void LLVMIRGen::GenFromAST(std::unique_ptr<PrimaryAST<LLVMValue>> node) {
+template<template<typename> class SymbolTable>
+void LLVMIRGen<SymbolTable>::GenFromAST(std::unique_ptr<PrimaryAST<LLVMValue>> node) {
+    if (failed) {
+        return;
+    }
     node->acceptIRGenVisitor(this);
 }
 
 // Prorotype overload.
 
-void LLVMIRGen::visit(PrototypeAST<LLVMValue>* proto) {
+template<template<typename> class SymbolTable>
+void LLVMIRGen<SymbolTable>::visit(PrototypeAST<LLVMValue>* proto) {
     auto *TheFunction = visitFunctionPrototypeImpl(proto);
 }
 // FunctionAST overload.
 
-void LLVMIRGen::visit(FunctionAST<LLVMValue>* node) {
+template<template<typename> class SymbolTable>
+void LLVMIRGen<SymbolTable>::visit(FunctionAST<LLVMValue>* node) {
     // calls the real implementation
     auto *TheFunction = visitFunctionImpl(node);
     if (TheFunction) {
@@ -108,11 +148,26 @@ void LLVMIRGen::visit(FunctionAST<LLVMValue>* node) {
 
 // Internal method for prototype function generation
 
-Function* LLVMIRGen::visitFunctionPrototypeImpl(PrototypeAST<LLVMValue>* node) {
+template<template<typename> class SymbolTable>
+Function* LLVMIRGen<SymbolTable>::visitFunctionPrototypeImpl(PrototypeAST<LLVMValue>* node) {
 
-    std::vector<Arg>& Args = node->getArgs();
-    const std::string& Name = node->getName();
     auto DI = node->getDebugInfo();
+    return createFunction(node->getName(), node->getReturnType(), node->getArgs(), DI.get());
+}
+
+template<template<typename> class SymbolTable>
+Function* LLVMIRGen<SymbolTable>::declareFunction(FunctionSignature& signature) {
+
+    if (Function *F = TheModule->getFunction(signature.name.str())) {
+        return F;
+    }
+    return createFunction(signature.name, signature.returnType, signature.args, nullptr);
+}
+
+template<template<typename> class SymbolTable>
+Function* LLVMIRGen<SymbolTable>::createFunction(Identifier name, VarType returnType,
+        std::vector<Arg>& Args, DebugInfo* DI) {
+
     // Make the function type:  double(double,double) etc.
     //std::vector<Type *> Doubles(Args.size(), Type::getDoubleTy(*TheContext));
 
@@ -123,20 +178,20 @@ Function* LLVMIRGen::visitFunctionPrototypeImpl(PrototypeAST<LLVMValue>* node) {
         } else if (arg.getType() == INTEGER) {
             ArgTypes.push_back(Type::getInt64Ty(*TheContext));
         } else {
-            std::cout << "unknown type in " << DI->getInfo() << std::endl;
+            std::cout << "unknown type in " << (DI ? DI->getInfo() : name.str()) << std::endl;
         }
     }
 
     FunctionType *FT =
-            FunctionType::get(convertType(node->getReturnType(), TheContext), ArgTypes, false);
+            FunctionType::get(convertType(returnType, TheContext), ArgTypes, false);
 
     Function *F =
-            Function::Create(FT, Function::ExternalLinkage, Name, TheModule.get());
+            Function::Create(FT, Function::ExternalLinkage, name.str(), TheModule.get());
 
     // Set names for all arguments.
     unsigned Idx = 0;
     for (auto &Arg : F->args()) {
-        Arg.setName(Args[Idx++].getName());
+        Arg.setName(Args[Idx++].getName().str());
     }
 
     return F;
@@ -144,11 +199,13 @@ Function* LLVMIRGen::visitFunctionPrototypeImpl(PrototypeAST<LLVMValue>* node) {
 
 // Private method for the real job. 
 
-Function* LLVMIRGen::visitFunctionImpl(FunctionAST<LLVMValue>* node) {
+template<template<typename> class SymbolTable>
+Function* LLVMIRGen<SymbolTable>::visitFunctionImpl(FunctionAST<LLVMValue>* node) {
     // First, check for an existing function from a previous 'extern' declaration.
-    const std::string& Name = node->getName();
+    const std::string& Name = node->getName().str();
     Function *TheFunction = TheModule->getFunction(Name);
     auto DI = node->getDebugInfo();
+    InlineHint hint = node->getInlineHint();
     if (!TheFunction) {
         // generator must owns the prototype pointer  
         std::unique_ptr<PrototypeAST < LLVMValue>> proto = node->getProto();
@@ -162,11 +219,24 @@ Function* LLVMIRGen::visitFunctionImpl(FunctionAST<LLVMValue>* node) {
 
     if (!TheFunction->empty()) {
         //rever
-        abort("Function already defined", Name, DI->getInfo());
+        fail("Function already defined", Name, DI->getInfo());
+        return nullptr;
+    }
+
+    // source attributes drive the inliner of the optimizer
+    if (hint == INLINE_ALWAYS) {
+        TheFunction->addFnAttr(Attribute::AlwaysInline);
+    } else if (hint == INLINE_NEVER) {
+        TheFunction->addFnAttr(Attribute::NoInline);
     }
 
     // Create a the first basic block and generate code.
     BasicBlock *BB = visitExpBlock(std::move(node->getBody()), "entry", TheFunction);
+    if (failed) {
+        // the body is incomplete, only the declaration is kept
+        TheFunction->deleteBody();
+        return nullptr;
+    }
 
     //Check for return
     //BasicBlock* lastBB = &TheFunction->back();
@@ -182,7 +252,8 @@ Function* LLVMIRGen::visitFunctionImpl(FunctionAST<LLVMValue>* node) {
 // Generate allocas for every function parameter plus the return value. We can optimize
 // these allcoas with men2reg pass.
 
-void LLVMIRGen::allocSpaceForParams(Function* function, BasicBlock* BB) {
+template<template<typename> class SymbolTable>
+void LLVMIRGen<SymbolTable>::allocSpaceForParams(Function* function, BasicBlock* BB) {
 
     std::list<AllocaInst*> allocas;
 
@@ -201,7 +272,7 @@ void LLVMIRGen::allocSpaceForParams(Function* function, BasicBlock* BB) {
         AllocaInst* Alloca = TmpB.CreateAlloca(function->getReturnType(), 0,
                 "retvalue");
 
-        symbolTable.insertSymbol("retvalue", StorageType::LOCAL, Alloca);
+        symbolTable.insertSymbol(RetValueName, StorageType::LOCAL, Alloca);
     }
 
     // Store params in the allocas
@@ -210,7 +281,7 @@ void LLVMIRGen::allocSpaceForParams(Function* function, BasicBlock* BB) {
         allocas.pop_front();
         Builder->CreateStore(&Arg, Alloca);
         // populate the symbol table
-        symbolTable.insertSymbol(Arg.getName().str(), StorageType::LOCAL, Alloca);
+        symbolTable.insertSymbol(Identifier(Arg.getName().str()), StorageType::LOCAL, Alloca);
     }
 
 
@@ -218,16 +289,18 @@ void LLVMIRGen::allocSpaceForParams(Function* function, BasicBlock* BB) {
 
 // Generate alloca for specific var
 
-Value* LLVMIRGen::allocLocalVar(Function* function, std::string& name, VarType type, DebugInfo* DI) {
+template<template<typename> class SymbolTable>
+Value* LLVMIRGen<SymbolTable>::allocLocalVar(Function* function, Identifier name, VarType type, DebugInfo* DI) {
 
     IRBuilder<> TmpB(&function->getEntryBlock(),
             function->getEntryBlock().begin());
 
     AllocaInst* Alloca = TmpB.CreateAlloca(convertType(type, TheContext), 0,
-            name);
+            name.str());
 
     if (symbolTable.contains(name)) {
-        abort("Variable already declared", name, DI->getInfo());
+        fail("Variable already declared", name.str(), DI->getInfo());
+        return nullptr;
     }
 
     symbolTable.insertSymbol(name, StorageType::LOCAL, Alloca);
@@ -237,7 +310,8 @@ Value* LLVMIRGen::allocLocalVar(Function* function, std::string& name, VarType t
 
 // Private method for expression block code generation.
 
-BasicBlock* LLVMIRGen::visitExpBlock(std::unique_ptr<ExprBlockAST<LLVMValue>> block,
+template<template<typename> class SymbolTable>
+BasicBlock* LLVMIRGen<SymbolTable>::visitExpBlock(std::unique_ptr<ExprBlockAST<LLVMValue>> block,
         std::string name, Function* function) {
 
     symbolTable.push_scope();
@@ -262,13 +336,13 @@ BasicBlock* LLVMIRGen::visitExpBlock(std::unique_ptr<ExprBlockAST<LLVMValue>> bl
         Builder->SetInsertPoint(BB);
     }
 
-    // generate IR for all expressions
-    while (!block->empty()) {
+    // generate IR for all expressions, the rest is skipped after an error
+    while (!block->empty() && !failed) {
         std::unique_ptr<ExprAST < LLVMValue>> expr = block->nextExp();
         expr->acceptIRGenVisitor(this);
     }
 
-    if (mainBlock) {
+    if (mainBlock && !failed) {
         // create the final return statement.
         currentRetBB->moveAfter(Builder->GetInsertBlock());
         Builder->SetInsertPoint(currentRetBB);
@@ -277,7 +351,7 @@ BasicBlock* LLVMIRGen::visitExpBlock(std::unique_ptr<ExprBlockAST<LLVMValue>> bl
         if (function->getReturnType() == Type::getVoidTy(*TheContext)) {
             Builder->CreateRetVoid();
         } else {
-            Symbol<LLVMValue>* retSymb = symbolTable.getSymbol("retvalue");
+            Symbol<LLVMValue>* retSymb = symbolTable.getSymbol(RetValueName);
             Value* retV = retSymb->getMemRef();
             Value* loadRet = Builder->CreateLoad(retV);
 
@@ -292,7 +366,8 @@ BasicBlock* LLVMIRGen::visitExpBlock(std::unique_ptr<ExprBlockAST<LLVMValue>> bl
     return BB;
 }
 
-void LLVMIRGen::visit(IfExprAST<LLVMValue>* ifexp) {
+template<template<typename> class SymbolTable>
+void LLVMIRGen<SymbolTable>::visit(IfExprAST<LLVMValue>* ifexp) {
 
     BasicBlock* parentBB = Builder->GetInsertBlock();
     BasicBlock* thenBB = nullptr;
@@ -304,7 +379,6 @@ void LLVMIRGen::visit(IfExprAST<LLVMValue>* ifexp) {
     std::unique_ptr<ExprAST < LLVMValue>> Condition = ifexp->getCondition();
 
     // then and merge blocks
-    contBB = BasicBlock::Create(*TheContext, "cont");
     thenBB = visitExpBlock(std::move(ThenBlock), "then", nullptr);
 
     // we deal with else blocks as optional
@@ -312,6 +386,10 @@ void LLVMIRGen::visit(IfExprAST<LLVMValue>* ifexp) {
         elseBB = visitExpBlock(std::move(ElseBlock), "else", nullptr);
 
     }
+    if (failed) {
+        return;
+    }
+    contBB = BasicBlock::Create(*TheContext, "cont");
 
     // branch from then to cont
     function->getBasicBlockList().push_back(contBB);
@@ -327,6 +405,9 @@ void LLVMIRGen::visit(IfExprAST<LLVMValue>* ifexp) {
     Builder->SetInsertPoint(parentBB);
 
     Value *CondValue = Condition->acceptIRGenVisitor(this);
+    if (failed) {
+        return;
+    }
     //CondValue = Builder->CreateFCmpONE(CondValue, ConstantFP::get(*TheContext,
     //       APFloat(0.0)), "ifcond");
 
@@ -352,11 +433,12 @@ void LLVMIRGen::visit(IfExprAST<LLVMValue>* ifexp) {
 
 // VariableExprAST overload
 
-llvm::Value* LLVMIRGen::visit(VariableExprAST<LLVMValue>* node) {
+template<template<typename> class SymbolTable>
+llvm::Value* LLVMIRGen<SymbolTable>::visit(VariableExprAST<LLVMValue>* node) {
 
     auto DI = node->getDebugInfo();
     if (!symbolTable.contains(node->getName())) {
-        abort("Variable not found", node->getName(), DI->getInfo());
+        fail("Variable not found", node->getName().str(), DI->getInfo());
         return nullptr;
     }
 
@@ -366,27 +448,30 @@ llvm::Value* LLVMIRGen::visit(VariableExprAST<LLVMValue>* node) {
     if (symbol->getStorageType() == StorageType::LOCAL) {
         return Builder->CreateLoad(symbol->getMemRef());
     }
-    abort("Not implemented ", DI->getInfo());
+    fail("Not implemented ", DI->getInfo());
 
     return nullptr;
 }
 
 // RealNumberExprAST overload.
 
-Value* LLVMIRGen::visit(RealNumberExprAST<LLVMValue>* node) {
+template<template<typename> class SymbolTable>
+Value* LLVMIRGen<SymbolTable>::visit(RealNumberExprAST<LLVMValue>* node) {
     return ConstantFP::get(*TheContext, APFloat(node->getVal()));
 }
 
 // IntegerNumberExprAST overload.
 
-Value* LLVMIRGen::visit(IntegerNumberExprAST<LLVMValue>* node) {
+template<template<typename> class SymbolTable>
+Value* LLVMIRGen<SymbolTable>::visit(IntegerNumberExprAST<LLVMValue>* node) {
     return ConstantInt::get(*TheContext, APSInt::get(node->getVal()));
 }
 
 
 // BinaryExprAST overload.
 
-Value* LLVMIRGen::visit(BinaryExprAST<LLVMValue>* node) {
+template<template<typename> class SymbolTable>
+Value* LLVMIRGen<SymbolTable>::visit(BinaryExprAST<LLVMValue>* node) {
 
     auto DI = node->getDebugInfo();
     Operation Op = node->getOp();
@@ -413,7 +498,7 @@ Value* LLVMIRGen::visit(BinaryExprAST<LLVMValue>* node) {
         Symbol<LLVMValue>* symb = symbolTable.getSymbol(LHSE->getName());
 
         if (!symb) {
-            abort("Unknown variable name", LHSE->getName(), DI->getInfo());
+            fail("Unknown variable name", LHSE->getName().str(), DI->getInfo());
             // return LogErrorV("destination of '=' must be a variable");
             return nullptr;
         }
@@ -429,7 +514,7 @@ Value* LLVMIRGen::visit(BinaryExprAST<LLVMValue>* node) {
         return nullptr;
 
     if (L->getType() != R->getType()) {
-        abort("Type incompatibility between operands", DI->getInfo());
+        fail("Type incompatibility between operands", DI->getInfo());
         return nullptr;
     }
 
@@ -440,7 +525,7 @@ Value* LLVMIRGen::visit(BinaryExprAST<LLVMValue>* node) {
             } else if (L->getType() == Type::getInt64Ty(*TheContext)) {
                 return Builder->CreateAdd(L, R, "addtmp");
             } else {
-                abort("Unimplemented operand type", DI->getInfo());
+                fail("Unimplemented operand type", DI->getInfo());
                 return nullptr;
             }
 
@@ -450,7 +535,7 @@ Value* LLVMIRGen::visit(BinaryExprAST<LLVMValue>* node) {
             } else if (L->getType() == Type::getInt64Ty(*TheContext)) {
                 return Builder->CreateSub(L, R, "subtmp");
             } else {
-                abort("Unimplemented operand type", DI->getInfo());
+                fail("Unimplemented operand type", DI->getInfo());
                 return nullptr;
             }
 
@@ -461,7 +546,7 @@ Value* LLVMIRGen::visit(BinaryExprAST<LLVMValue>* node) {
             } else if (L->getType() == Type::getInt64Ty(*TheContext)) {
                 return Builder->CreateMul(L, R, "multmp");
             } else {
-                abort("Unimplemented operand type", DI->getInfo());
+                fail("Unimplemented operand type", DI->getInfo());
                 return nullptr;
             }
 
@@ -475,7 +560,7 @@ Value* LLVMIRGen::visit(BinaryExprAST<LLVMValue>* node) {
                 L = Builder->CreateICmpEQ(L, R, "eqtmp");
                 return L;
             } else {
-                abort("Unimplemented operand type", DI->getInfo());
+                fail("Unimplemented operand type", DI->getInfo());
                 return nullptr;
             }
 
@@ -491,12 +576,12 @@ Value* LLVMIRGen::visit(BinaryExprAST<LLVMValue>* node) {
                 L = Builder->CreateICmpSLT(L, R, "eqtmp");
                 return L;
             } else {
-                abort("Unimplemented operand type", DI->getInfo());
+                fail("Unimplemented operand type", DI->getInfo());
                 return nullptr;
             }
 
         default:
-            abort("Unknown operand: ", std::string(1, Op));
+            fail("Unknown operand: ", std::string(1, Op));
             break;
     }
 
@@ -504,7 +589,8 @@ Value* LLVMIRGen::visit(BinaryExprAST<LLVMValue>* node) {
     return nullptr;
 }
 
-Value* LLVMIRGen::visit(UnaryExprAST<LLVMValue>* node) {
+template<template<typename> class SymbolTable>
+Value* LLVMIRGen<SymbolTable>::visit(UnaryExprAST<LLVMValue>* node) {
 
     auto DI = node->getDebugInfo();
     std::unique_ptr<ExprAST < LLVMValue>> LRHS = node->getLRHS();
@@ -514,15 +600,18 @@ Value* LLVMIRGen::visit(UnaryExprAST<LLVMValue>* node) {
 
     VariableExprAST<LLVMValue> *LHSE = static_cast<VariableExprAST<LLVMValue> *> (LRHS.get());
     if (!LHSE) {
-        abort("unary operand must be a variable", DI->getInfo());
+        fail("unary operand must be a variable", DI->getInfo());
         // return LogErrorV("destination of '=' must be a variable");
         return nullptr;
     }
 
     Value* var = LHSE->acceptIRGenVisitor(this);
+    if (failed) {
+        return nullptr;
+    }
     Symbol<LLVMValue>* sym = symbolTable.getSymbol(LHSE->getName());
     if (!sym) {
-        abort("Unknown symbol: ", LHSE->getName());
+        fail("Unknown symbol: ", LHSE->getName().str());
         return nullptr;
     }
 
@@ -546,7 +635,7 @@ Value* LLVMIRGen::visit(UnaryExprAST<LLVMValue>* node) {
 
             break;
         default:
-            abort("Unimplemented unary operator", DI->getInfo());
+            fail("Unimplemented unary operator", DI->getInfo());
             return nullptr;
     }
     Builder->CreateStore(result, sym->getMemRef());
@@ -561,7 +650,8 @@ Value* LLVMIRGen::visit(UnaryExprAST<LLVMValue>* node) {
 
 // ReturnAST overload
 
-void LLVMIRGen::visit(ReturnAST<LLVMValue>* ifexp) {
+template<template<typename> class SymbolTable>
+void LLVMIRGen<SymbolTable>::visit(ReturnAST<LLVMValue>* ifexp) {
 
     auto DI = ifexp->getDebugInfo();
     std::unique_ptr<ExprAST < LLVMValue>> RHS = ifexp->getExpr();
@@ -571,22 +661,29 @@ void LLVMIRGen::visit(ReturnAST<LLVMValue>* ifexp) {
     /// we have a void return
     if (function->getReturnType() == Type::getVoidTy(*TheContext)) {
         if (RHS) {
-            abort("Void functions cannot return a value", DI->getInfo());
+            fail("Void functions cannot return a value", DI->getInfo());
+            return;
         }
     } else {
         // for non void functions this method only saves the Value of the expression in the 
         // "retvalue" alloca and jumps to the return block.
         if (!RHS) {
-            abort("A non void function must return a value", DI->getInfo());
+            fail("A non void function must return a value", DI->getInfo());
+            return;
         }
 
         Value* Expr = RHS->acceptIRGenVisitor(this);
+        if (failed) {
+            return;
+        }
 
-        if (function->getReturnType() != Expr->getType()) {
-            abort("Type incompatibility between returned expression and function's return type", DI->getInfo());
+        // a call to a void function has no value
+        if (!Expr || function->getReturnType() != Expr->getType()) {
+            fail("Type incompatibility between returned expression and function's return type", DI->getInfo());
+            return;
         }
 
-        Symbol<LLVMValue>* retSymb = symbolTable.getSymbol("retvalue");
+        Symbol<LLVMValue>* retSymb = symbolTable.getSymbol(RetValueName);
         Builder->CreateStore(Expr, retSymb->getMemRef());
     }
 
@@ -597,18 +694,19 @@ void LLVMIRGen::visit(ReturnAST<LLVMValue>* ifexp) {
 
 // CallExprAST overload
 
-llvm::Value* LLVMIRGen::visit(CallExprAST<LLVMValue>* node) {
+template<template<typename> class SymbolTable>
+llvm::Value* LLVMIRGen<SymbolTable>::visit(CallExprAST<LLVMValue>* node) {
     // Look up the name in the global module table.
     auto DI = node->getDebugInfo();
-    Function *CalleeF = TheModule->getFunction(node->getCalee());
+    Function *CalleeF = TheModule->getFunction(node->getCalee().str());
     if (!CalleeF) {
-        abort("Unknown function referenced", node->getCalee(), DI->getInfo());
+        fail("Unknown function referenced", node->getCalee().str(), DI->getInfo());
         return nullptr;
     }
     std::vector<std::unique_ptr < ExprAST < LLVMValue>>> Args = node->getArgs();
     // If argument mismatch error.
     if (CalleeF->arg_size() != Args.size()) {
-        abort("Incorrect # arguments passed", DI->getInfo());
+        fail("Incorrect # arguments passed", DI->getInfo());
         return nullptr;
     }
     //check parameter compatibility and construct the vector
@@ -618,10 +716,13 @@ llvm::Value* LLVMIRGen::visit(CallExprAST<LLVMValue>* node) {
         // real argument
         Argument& ActualArg = *I;
         Value* Arg = Args[i]->acceptIRGenVisitor(this);
+        if (failed) {
+            return nullptr;
+        }
 
         //check types
-        if (ActualArg.getType() != Arg->getType()) {
-            abort("Type incompatibility between provided and expected arguments", DI->getInfo());
+        if (!Arg || ActualArg.getType() != Arg->getType()) {
+            fail("Type incompatibility between provided and expected arguments", DI->getInfo());
             return nullptr;
         }
         I++;
@@ -639,19 +740,24 @@ llvm::Value* LLVMIRGen::visit(CallExprAST<LLVMValue>* node) {
 
 // LocalVarDeclarationExprAST overload
 
-llvm::Value* LLVMIRGen::visit(LocalVarDeclarationExprAST<LLVMValue>* node) {
+template<template<typename> class SymbolTable>
+llvm::Value* LLVMIRGen<SymbolTable>::visit(LocalVarDeclarationExprAST<LLVMValue>* node) {
 
     auto DI = node->getDebugInfo();
-    std::string name = node->getName();
+    Identifier name = node->getName();
     std::unique_ptr<ExprAST < LLVMValue>> Exp = node->getInitalizer();
     VarType type = node->getType();
     Value* allocated = allocLocalVar(Builder->GetInsertBlock()->getParent(), name, type, DI.get());
+    if (!allocated) {
+        return nullptr;
+    }
 
     Value* initializer = Exp->acceptIRGenVisitor(this);
 
     if (initializer) {
         if (convertType(type, TheContext) != initializer->getType()) {
-            abort("Type incompatibility between variable and its initializer", DI->getInfo());
+            fail("Type incompatibility between variable and its initializer", DI->getInfo());
+            return nullptr;
         }
         Builder->CreateStore(initializer, allocated);
     }
@@ -662,7 +768,8 @@ llvm::Value* LLVMIRGen::visit(LocalVarDeclarationExprAST<LLVMValue>* node) {
 
 // ForExprAST overload
 
-void LLVMIRGen::visit(ForExprAST<LLVMValue>* forExpr) {
+template<template<typename> class SymbolTable>
+void LLVMIRGen<SymbolTable>::visit(ForExprAST<LLVMValue>* forExpr) {
 
     BasicBlock* parentBB = Builder->GetInsertBlock();
     BasicBlock* BodyBB = nullptr;
@@ -684,6 +791,10 @@ void LLVMIRGen::visit(ForExprAST<LLVMValue>* forExpr) {
 
     if (Block) {
         BodyBB = visitExpBlock(std::move(Block), "forBody", nullptr);
+        if (failed) {
+            symbolTable.pop_scope();
+            return;
+        }
         // get and updated vertion of the basic block. If we have inserted more blocks
         // we need to continue from tha last block.
         LastBodyBB = &function->getBasicBlockList().back();
@@ -735,6 +846,10 @@ void LLVMIRGen::visit(ForExprAST<LLVMValue>* forExpr) {
         // branch from header to body
         cond = ConstantInt::get(*TheContext, APInt(1, 1, false));
     }
+    if (failed) {
+        symbolTable.pop_scope();
+        return;
+    }
     Builder->CreateCondBr(cond, BodyBB, ContBB);
 
     // branch from body to header
@@ -753,7 +868,8 @@ void LLVMIRGen::visit(ForExprAST<LLVMValue>* forExpr) {
 
 // WhileExprAST overload
 
-void LLVMIRGen::visit(WhileExprAST<LLVMValue>* forExpr) {
+template<template<typename> class SymbolTable>
+void LLVMIRGen<SymbolTable>::visit(WhileExprAST<LLVMValue>* forExpr) {
 
     BasicBlock* parentBB = Builder->GetInsertBlock();
     BasicBlock* BodyBB = nullptr;
@@ -767,6 +883,9 @@ void LLVMIRGen::visit(WhileExprAST<LLVMValue>* forExpr) {
 
     if (Block) {
         BodyBB = visitExpBlock(std::move(Block), "whileBody", nullptr);
+        if (failed) {
+            return;
+        }
         LastBodyBB = &function->getBasicBlockList().back();
     } else {
         // empty BB
@@ -790,6 +909,9 @@ void LLVMIRGen::visit(WhileExprAST<LLVMValue>* forExpr) {
 
     Builder->SetInsertPoint(HeaderBB);
     Value* cond = Cond->acceptIRGenVisitor(this);
+    if (failed) {
+        return;
+    }
 
     Builder->CreateCondBr(cond, BodyBB, ContBB);
     // branch from body to header
@@ -806,6 +928,11 @@ void LLVMIRGen::visit(WhileExprAST<LLVMValue>* forExpr) {
 
 // Transfer the pointer out of this object.
 
-std::unique_ptr<Module> LLVMIRGen::getModule() {
+template<template<typename> class SymbolTable>
+std::unique_ptr<Module> LLVMIRGen<SymbolTable>::getModule() {
     return std::move(TheModule);
 }
+
+// one generator per symbol table implementation
+template class LLVMIRGen<ListSymbolTable>;
+template class LLVMIRGen<HashSymbolTable>;
@@ -30,6 +30,7 @@
 #include <map>
 #include "AST.h"
 #include "ListSymbolTable.h"
+#include "HashSymbolTable.h"
 #include "LangDefs.h"
 #include "AbstractIRGen.h"
 
@@ -39,7 +40,19 @@ using LLVMValue = llvm::Value*;
 
 using namespace llvm;
 
-// consumes the AST generating LLVM IR
+// what declareFunction needs to know about a function generated elsewhere
+struct FunctionSignature {
+    Identifier name;
+    VarType returnType;
+    std::vector<Arg> args;
+};
+
+// signature of a function generated by LLVMIRGen
+FunctionSignature getFunctionSignature(llvm::Function& F);
+
+// consumes the AST generating LLVM IR, SymbolTable keeps the local variables
+// (ListSymbolTable or HashSymbolTable)
+template<template<typename> class SymbolTable = HashSymbolTable>
 class LLVMIRGen : public AbstractIRGen<LLVMValue>{
 public:
     LLVMIRGen(LLVMContext* TheContext);
@@ -58,9 +71,16 @@ public:
     virtual llvm::Value* visit(CallExprAST<LLVMValue>* node) override;
     virtual llvm::Value* visit(LocalVarDeclarationExprAST<LLVMValue>* node) override;
     virtual std::unique_ptr<Module> getModule() override;
+    // declares a function of another module (e.g. one generated by another
+    // thread), so calls to it can be generated in this one
+    llvm::Function* declareFunction(FunctionSignature& signature);
+    virtual bool hasFail() override {
+        return failed;
+    }
     
 private:
-    ListSymbolTable<LLVMValue> symbolTable;
+    bool failed = false;
+    SymbolTable<LLVMValue> symbolTable;
     LLVMContext* TheContext;
     llvm::BasicBlock* currentRetBB = nullptr;
     std::unique_ptr<legacy::FunctionPassManager> TheFPM;
@@ -68,12 +88,16 @@ private:
     std::unique_ptr<Module> TheModule;
     std::map<std::string, llvm::Value *> NamedValues;
     llvm::Function* visitFunctionPrototypeImpl(PrototypeAST<LLVMValue>* node);
+    llvm::Function* createFunction(Identifier name, VarType returnType, std::vector<Arg>& Args,
+        DebugInfo* DI);
     llvm::Function* visitFunctionImpl(FunctionAST<LLVMValue>* node);
     llvm::BasicBlock* visitExpBlock(std::unique_ptr<ExprBlockAST<LLVMValue>> block, 
         std::string name, Function* function);
     
     void allocSpaceForParams(Function* function, BasicBlock* BB);
-    llvm::Value*  allocLocalVar(Function* function, std::string& name, VarType type, DebugInfo* DI);
+    llvm::Value*  allocLocalVar(Function* function, Identifier name, VarType type, DebugInfo* DI);
+    void fail(const char *Str, std::string loc);
+    void fail(const char *Str, std::string msg, std::string loc);
     
 };
 
@@ -54,5 +54,13 @@ enum VarType{
     UNIMPLEMENTED
 };
 
+/// Inlining attribute of a function definition
+
+enum InlineHint{
+    INLINE_DEFAULT = 0,
+    INLINE_ALWAYS,
+    INLINE_NEVER
+};
+
 #endif	/* LANGOPS_H */
 
@@ -17,130 +17,471 @@
 
 
 #include "Lexer.h"
-#include <cctype>
+#include "SourceManager.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 
-Lexer::Lexer(const char* begin, const char* end, std::string FileName) {
+// Character classes of the scanner, one table lookup per character.
+
+enum CharClass : uint8_t {
+    CC_SPACE = 1,
+    CC_ALPHA = 2,
+    CC_DIGIT = 4,
+    CC_ALNUM = CC_ALPHA | CC_DIGIT
+};
+
+static constexpr std::array<uint8_t, 256> makeCharClasses() {
+    std::array<uint8_t, 256> classes{};
+    for (int c = 'a'; c <= 'z'; c++) {
+        classes[c] = CC_ALPHA;
+    }
+    for (int c = 'A'; c <= 'Z'; c++) {
+        classes[c] = CC_ALPHA;
+    }
+    for (int c = '0'; c <= '9'; c++) {
+        classes[c] = CC_DIGIT;
+    }
+    for (int c : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+        classes[c] = CC_SPACE;
+    }
+    return classes;
+}
+
+static constexpr std::array<uint8_t, 256> CharClasses = makeCharClasses();
+
+static inline bool hasClass(int c, uint8_t cls) {
+    return c != EOF && (CharClasses[(unsigned char) c] & cls);
+}
+
+// Precedence of the binary operators, indexed by Operation. 1 is lowest
+// precedence, 0 means not a binary operator.
+static const int BinopPrecedence[] = {
+    /* UNKNOWN */ 0,
+    /* ASSIGN */ 2,
+    /* EQ */ 12,
+    /* LT */ 10,
+    /* LEQ */ 0,
+    /* GT */ 0,
+    /* GEQ */ 0,
+    /* ADD */ 20,
+    /* INC */ 0,
+    /* DEC */ 0,
+    /* SUB */ 20,
+    /* MUL */ 40, // highest.
+    /* DIV */ 0
+};
+
+// Keyword token of an identifier, or tok_identifier. Switching on the length
+// first leaves at most two candidates to compare.
+
+static int getKeywordToken(const char* str, size_t length) {
+
+    auto is = [str, length](const char* keyword) {
+        return memcmp(str, keyword, length) == 0;
+    };
+
+    switch (length) {
+        case 2:
+            if (is("if")) return tok_if;
+            break;
+        case 3:
+            if (is("for")) return tok_for;
+            if (is("let")) return tok_let;
+            break;
+        case 4:
+            if (is("else")) return tok_else;
+            if (is("real") || is("none")) return tok_type;
+            break;
+        case 5:
+            if (is("while")) return tok_while;
+            break;
+        case 6:
+            switch (str[0]) {
+                case 'e':
+                    if (is("extern")) return tok_extern;
+                    break;
+                case 'r':
+                    if (is("return")) return tok_return;
+                    break;
+                case 's':
+                    if (is("string")) return tok_type;
+                    break;
+                case 'i':
+                    if (is("inline")) return tok_inline;
+                    break;
+            }
+            break;
+        case 7:
+            if (is("integer")) return tok_type;
+            break;
+        case 8:
+            if (is("function")) return tok_function;
+            if (is("noinline")) return tok_noinline;
+            break;
+    }
+    return tok_identifier;
+}
+
+// Interned spelling of a keyword token found by getKeywordToken. The type
+// names share tok_type and differ in their first letter.
+
+static Identifier getKeywordIdentifier(int token, const char* str) {
+
+    static const struct KeywordIdentifiers {
+        Identifier byToken[-tok_noinline + 1];
+        Identifier real{"real"}, none{"none"}, string{"string"}, integer{"integer"};
+
+        KeywordIdentifiers() {
+            byToken[-tok_function] = Identifier("function");
+            byToken[-tok_extern] = Identifier("extern");
+            byToken[-tok_if] = Identifier("if");
+            byToken[-tok_else] = Identifier("else");
+            byToken[-tok_for] = Identifier("for");
+            byToken[-tok_while] = Identifier("while");
+            byToken[-tok_return] = Identifier("return");
+            byToken[-tok_let] = Identifier("let");
+            byToken[-tok_inline] = Identifier("inline");
+            byToken[-tok_noinline] = Identifier("noinline");
+        }
+    } words;
+
+    if (token != tok_type) {
+        return words.byToken[-token];
+    }
+    switch (str[0]) {
+        case 'r':
+            return words.real;
+        case 'n':
+            return words.none;
+        case 's':
+            return words.string;
+        default:
+            return words.integer;
+    }
+}
+
+// Powers of ten exactly representable as doubles.
+static const double ExactPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Value of the real literal [str, str + length). When the digits fit in the
+// 53 bits of the mantissa and the scale is an exact power of ten, a single
+// division is correctly rounded (Clinger's fast path); strtod otherwise.
+
+static double parseReal(const char* str, size_t length) {
+
+    uint64_t mantissa = 0;
+    unsigned digits = 0, fractionDigits = 0;
+    bool seenDot = false, exact = true;
+
+    for (size_t i = 0; i < length && exact; i++) {
+        if (str[i] == '.') {
+            // "1.2.3" is read as 1.2 by strtod
+            exact = !seenDot;
+            seenDot = true;
+        } else {
+            mantissa = mantissa * 10 + (str[i] - '0');
+            fractionDigits += seenDot;
+            // leading zeros do not take mantissa bits
+            digits += digits > 0 || str[i] != '0';
+            exact = digits <= 15 && fractionDigits <= 22;
+        }
+    }
+
+    if (exact) {
+        return (double) mantissa / ExactPowersOfTen[fractionDigits];
+    }
+    return strtod(std::string(str, length).c_str(), nullptr);
+}
+
+// Number literal ([0-9.]+) starting at start; next is left past it.
+
+static int scanNumber(const char* start, const char*& next, const char* end, double& value) {
+
+    bool isReal = false;
+    const char* p = start;
+    while (p != end && (hasClass((unsigned char) *p, CC_DIGIT) || *p == '.')) {
+        isReal |= *p == '.';
+        p++;
+    }
+    next = p;
+
+    if (isReal) {
+        value = parseReal(start, p - start);
+        return tok_real;
+    }
+    // saturates on overflow, as strtoll did
+    int64_t integer = INT64_MAX;
+    std::from_chars(start, p, integer);
+    value = integer;
+    return tok_integer;
+}
+
+// Operator starting with c, next is the character after it and is consumed
+// when it completes the operator ("==", "++", "--"). Any other character
+// is a token of its own; the operation is only set for tok_operator.
+
+static int scanOperator(int c, const char*& next, const char* end, Operation& operation,
+        OperationType& opType) {
+
+    auto follows = [&next, end](char second) {
+        if (next != end && *next == second) {
+            next++;
+            return true;
+        }
+        return false;
+    };
+
+    Operation op;
+    OperationType type = OperationType::BINARY;
+    switch (c) {
+        case '=':
+            op = follows('=') ? Operation::EQ : Operation::ASSIGN;
+            break;
+        case '<':
+            op = Operation::LT;
+            break;
+        case '+':
+            if (follows('+')) {
+                op = Operation::INC;
+                type = OperationType::UNARY;
+            } else {
+                op = Operation::ADD;
+            }
+            break;
+        case '-':
+            if (follows('-')) {
+                op = Operation::DEC;
+                type = OperationType::UNARY;
+            } else {
+                op = Operation::SUB;
+            }
+            break;
+        case '*':
+            op = Operation::MUL;
+            break;
+        case '/':
+            op = Operation::DIV;
+            break;
+        default:
+            return c;
+    }
+    operation = op;
+    opType = type;
+    return tok_operator;
+}
+
+Lexer::Lexer(unsigned FileID) : FileID(FileID) {
+    llvm::StringRef buffer = SourceManager::get().getBuffer(FileID);
+    begin = buffer.begin();
     current = begin;
-    this->end = end;
-    FileName = std::move(FileName);
-    // Install standard binary operators.
-    // 1 is lowest precedence.
-    BinopPrecedence[Operation::ASSIGN] = 2;
-    BinopPrecedence[Operation::LT] = 10;
-    BinopPrecedence[Operation::EQ] = 12;
-    BinopPrecedence[Operation::ADD] = 20;
-    BinopPrecedence[Operation::SUB] = 20;
-    BinopPrecedence[Operation::MUL] = 40; // highest.
+    end = buffer.end();
     getNextToken();
 }
 
+Lexer::Lexer(std::shared_ptr<const TokenBuffer> tokens, size_t first, size_t last) :
+FileID(tokens->getFileID()), begin(nullptr), current(nullptr), end(nullptr),
+tokens(std::move(tokens)), cursor(first) {
+    lastToken = std::min(last, this->tokens->size());
+    loadToken(cursor);
+}
+
+// The batch loop of the pre-tokenized mode: the same scanner as getTok, but
+// written straight into the arrays of the buffer, without the state of a
+// streaming lexer.
+
+std::shared_ptr<TokenBuffer> Lexer::tokenize(unsigned FileID) {
+
+    llvm::StringRef buffer = SourceManager::get().getBuffer(FileID);
+    const char* begin = buffer.begin();
+    const char* end = buffer.end();
+    auto tokens = std::make_shared<TokenBuffer>(FileID);
+    // rarely more than one token every four bytes of source, so the
+    // arrays do not grow; pages never written are never touched
+    tokens->reserve(buffer.size() / 4 + 1);
+
+    // names repeat a lot in a file, recently seen ones are found here
+    // without hashing and locking in the identifier pool
+    static const size_t RecentSize = 256;
+    Identifier recent[RecentSize];
+
+    const char* p = begin;
+    while (true) {
+        while (p != end && hasClass((unsigned char) *p, CC_SPACE)) {
+            p++;
+        }
+        if (p != end && *p == '#') {
+            while (p != end && *p != '\n' && *p != '\r') {
+                p++;
+            }
+            continue;
+        }
+
+        uint32_t offset = p - begin;
+        if (p == end) {
+            tokens->add(tok_eof, offset);
+            break;
+        }
+
+        const char* start = p;
+        unsigned char c = *p++;
+        if (hasClass(c, CC_ALPHA)) {
+            while (p != end && hasClass((unsigned char) *p, CC_ALNUM)) {
+                p++;
+            }
+            size_t length = p - start;
+            int token = getKeywordToken(start, length);
+            if (token != tok_identifier) {
+                tokens->addWord(token, offset, getKeywordIdentifier(token, start));
+                continue;
+            }
+            Identifier& cached = recent[(length * 31 + start[0] * 7 + p[-1]) % RecentSize];
+            const std::string& name = cached.str();
+            if (name.size() != length || memcmp(name.data(), start, length) != 0) {
+                cached = Identifier(start, length);
+            }
+            tokens->addWord(token, offset, cached);
+        } else if (hasClass(c, CC_DIGIT) || c == '.') {
+            double value;
+            int token = scanNumber(start, p, end, value);
+            tokens->addNumber(token, offset, value);
+        } else {
+            Operation operation;
+            OperationType opType;
+            int token = scanOperator(c, p, end, operation, opType);
+            if (token == tok_operator) {
+                tokens->addOperator(token, offset, operation, opType);
+            } else {
+                tokens->add(token, offset);
+            }
+        }
+    }
+    return tokens;
+}
+
+// Make token idx of the buffer the current one.
+
+void Lexer::loadToken(size_t idx) {
+
+    if (idx >= lastToken) {
+        CurTok = tok_eof;
+        tokOffset = lastToken < tokens->size() ? tokens->getOffset(lastToken) :
+                tokens->getOffset(tokens->size() - 1);
+        return;
+    }
+
+    CurTok = tokens->getKind(idx);
+    tokOffset = tokens->getOffset(idx);
+    switch (CurTok) {
+        case tok_real:
+            NumValReal = tokens->getNumber(idx);
+            break;
+        case tok_integer:
+            NumValInteger = tokens->getNumber(idx);
+            break;
+        case tok_operator:
+            CurrOperation = tokens->getOperation(idx);
+            CurrOpType = tokens->getOpType(idx);
+            break;
+        case tok_eof:
+            break;
+        default:
+            // identifiers, type names and keywords
+            if (CurTok < 0) {
+                CurIdentifier = tokens->getIdentifier(idx);
+            }
+            break;
+    }
+}
+
 int Lexer::getCurrentToken() {
     return CurTok;
 }
 
 int Lexer::getNextToken() {
 
+    if (tokens) {
+        loadToken(++cursor);
+        return CurTok;
+    }
     CurTok = getTok();
     return CurTok;
 }
 
+int Lexer::peekToken(unsigned n) {
+
+    if (tokens) {
+        return cursor + n < lastToken ? tokens->getKind(cursor + n) : (int) tok_eof;
+    }
+
+    // streaming mode: scan ahead, then put the scanner back
+    Lexer saved = *this;
+    int token = CurTok;
+    for (unsigned i = 0; i < n && token != tok_eof; i++) {
+        token = getTok();
+    }
+    *this = saved;
+    return token;
+}
+
 int Lexer::NextChar() {
     if (current == end) {
         LastChar = EOF;
     } else {
-        LastChar = *current;
+        LastChar = (unsigned char) *current;
         current++;
-        LineStr += LastChar;
     }
     return LastChar;
 }
 
+// Tokens are scanned straight from the buffer. LastChar is the first char
+// not consumed by the previous token, it was already read from current - 1.
+
 int Lexer::getTok() {// gettok - Return the next token from standard input.
     // Skip any whitespace.
+    while (hasClass(LastChar, CC_SPACE)) {
+        NextChar();
+    }
 
+    tokOffset = current - begin - (LastChar != EOF);
+    const char* tokStart = begin + tokOffset;
 
-    while (isspace(LastChar)) {
-        if (LastChar == '\n') {
-            line++;
-            col = 1;
-            LineStr = "";
-        } else {
-            col++;
+    if (hasClass(LastChar, CC_ALPHA)) { // identifier: [a-zA-Z][a-zA-Z0-9]*
+        while (current != end && hasClass((unsigned char) *current, CC_ALNUM)) {
+            current++;
         }
+        size_t length = current - tokStart;
         NextChar();
-    }
-    tokCol = col;
-    if (isalpha(LastChar)) { // identifier: [a-zA-Z][a-zA-Z0-9]*
-        IdentifierStr = LastChar;
-        while (isalnum(NextChar())) {
-            col++;
-            IdentifierStr += LastChar;
-        }
 
-        if (IdentifierStr == "function")
-            return tok_function;
-        if (IdentifierStr == "extern")
-            return tok_extern;
-        if (IdentifierStr == "return")
-            return tok_return;
-        if (IdentifierStr == "if")
-            return tok_if;
-        if (IdentifierStr == "else")
-            return tok_else;
-        if (IdentifierStr == "for")
-            return tok_for;
-        if (IdentifierStr == "while")
-            return tok_while;
-        if (IdentifierStr == "real") {
-            return tok_type;
+        IdentifierStr.assign(tokStart, length);
+        int token = getKeywordToken(tokStart, length);
+        if (token == tok_identifier) {
+            CurIdentifier = Identifier(tokStart, length);
         }
-        if (IdentifierStr == "integer") {
-            return tok_type;
-        }
-        if (IdentifierStr == "string") {
-            return tok_type;
-        }
-        if (IdentifierStr == "none") {
-            return tok_type;
-        }
-        if (IdentifierStr == "let") {
-            return tok_let;
-        }
-        if (IdentifierStr == "for") {
-            return tok_for;
-        }
-        return tok_identifier;
+        return token;
     }
 
-    if (isdigit(LastChar) || LastChar == '.') { // Number: [0-9.]+
-        std::string NumStr;
-        do {
-            NumStr += LastChar;
-            NextChar();
-            col++;
-        } while (isdigit(LastChar) || LastChar == '.');
-
-        std::size_t found = NumStr.find('.');
-        if (found != std::string::npos) {
-            NumValReal = strtod(NumStr.c_str(), nullptr);
-            return tok_real;
-        } else {
-            NumValInteger = strtoll(NumStr.c_str(), nullptr, 0);
-            return tok_integer;
-        }
-
+    if (hasClass(LastChar, CC_DIGIT) || LastChar == '.') { // Number: [0-9.]+
+        double value;
+        int token = scanNumber(tokStart, current, end, value);
+        NextChar();
+        (token == tok_real ? NumValReal : NumValInteger) = value;
+        return token;
     }
 
     if (LastChar == '#') {
         // Comment until end of line.
-        do {
-            NextChar();
-        } while (LastChar != EOF && LastChar != '\n' && LastChar != '\r');
-        line++;
-        col = 1;
+        while (current != end && *current != '\n' && *current != '\r') {
+            current++;
+        }
+        NextChar();
         if (LastChar != EOF)
             return getTok();
     }
@@ -151,70 +492,18 @@ int Lexer::getTok() {// gettok - Return the next token from standard input.
 
     // Otherwise, just return the character as its ascii value.
     int ThisChar = LastChar;
+    int token = scanOperator(ThisChar, current, end, CurrOperation, CurrOpType);
     NextChar();
-    col++;
-    CurrOperation = Operation::UNKNOWN;
-    CurrOpType = OperationType::BINARY;
-    switch (ThisChar) {
-        case '=':
-        {
-            if (LastChar == '=') {
-                NextChar();
-                col++;
-                CurrOperation = Operation::EQ;
-            } else {
-                CurrOperation = Operation::ASSIGN;
-            }
-            break;
-        }
-        case '<':
-        {
-            CurrOperation = Operation::LT;
-            break;
-        }
-        case '+':
-        {
-            if (LastChar == '+') {
-                NextChar();
-                col++;
-                CurrOperation = Operation::INC;
-                CurrOpType = OperationType::UNARY;
-            } else {
-                CurrOperation = Operation::ADD;
-            }
-            break;
-        }
-        case '-':
-        {
-            if (LastChar == '-') {
-                NextChar();
-                col++;
-                CurrOperation = Operation::DEC;
-                CurrOpType = OperationType::UNARY;
-            } else {
-                CurrOperation = Operation::SUB;
-            }
-            break;
-        }
-        case '*':
-        {
-            CurrOperation = Operation::MUL;
-            break;
-        }
-        case '/':
-        {
-            CurrOperation = Operation::DIV;
-            break;
-        }
-        default:
-            return ThisChar;
-    }
+    return token;
+}
 
-    return tok_operator;
+const std::string& Lexer::getIdentifierStr() {
+    // words are interned in pre-tokenized mode
+    return tokens ? CurIdentifier.str() : IdentifierStr;
 }
 
-std::string Lexer::getIdentifierStr() {
-    return IdentifierStr;
+Identifier Lexer::getIdentifier() {
+    return CurIdentifier;
 }
 
 double Lexer::getNumValReal() {
@@ -245,18 +534,10 @@ int Lexer::GetTokPrecedence() {
     return TokPrec;
 }
 
-int Lexer::GetTokLine() {
-    return line;
-}
-
-int Lexer::GetTokCol() {
-    return tokCol;
-}
-
-std::string& Lexer::getFileName() {
-    return FileName;
+unsigned Lexer::getFileID() {
+    return FileID;
 }
 
-std::string Lexer::getLineStr() {
-    return LineStr;
+uint32_t Lexer::GetTokOffset() {
+    return tokOffset;
 }
\ No newline at end of file
@@ -21,8 +21,11 @@
 #include <sstream>
 #include <string>
 #include <map>
+#include <cstdint>
 
 #include "LangDefs.h"
+#include "Identifier.h"
+#include "TokenBuffer.h"
 
 // The lexer returns tokens [0-255] if it is an unknown character, otherwise one
 // of these for known things.
@@ -63,45 +66,62 @@ enum Token {
     tok_integer = -18,
             
     // variable declaration
-    tok_let = -19
+    tok_let = -19,
+
+    // function attributes
+    tok_inline = -20,
+    tok_noinline = -21
 };
 
 class Lexer {
 public:
-    Lexer(const char* begin, const char* end , std::string filename);
+    // lexes a whole buffer of the SourceManager
+    Lexer(unsigned FileID);
+    // reads the tokens [first, last) of a pre-tokenized buffer, tok_eof after
+    Lexer(std::shared_ptr<const TokenBuffer> tokens, size_t first = 0,
+            size_t last = SIZE_MAX);
+
+    // lexes a whole buffer in one go
+    static std::shared_ptr<TokenBuffer> tokenize(unsigned FileID);
 
     int getCurrentToken();
     int getNextToken();
-    std::string getIdentifierStr();
+    // kind of the n-th token after the current one, without consuming it
+    int peekToken(unsigned n = 1);
+    const std::string& getIdentifierStr();
+    Identifier getIdentifier();
     Operation getOperation();
     OperationType getOpType();
     double getNumValReal();
     double getNumValInteger();
     int GetTokPrecedence();
-    int GetTokLine();
-    int GetTokCol();
-    std::string& getFileName();
-    std::string getLineStr();
+    // location of the current token
+    unsigned getFileID();
+    uint32_t GetTokOffset();
 
 private:
     int CurTok = ';';
     int LastChar = ' ';
-    int line = 1;
-    int col = 1;
-    int tokCol = 1;
-    std::map<Operation, int> BinopPrecedence;
+    uint32_t tokOffset = 0;
     //std::unique_ptr<std::ifstream> file;
-    std::string IdentifierStr; // Filled in if tok_identifier
-    std::string LineStr;
+    std::string IdentifierStr; // Filled in if tok_identifier or tok_type
+    Identifier CurIdentifier; // Interned IdentifierStr, if tok_identifier
     double NumValReal; // Filled in if tok_real
     double NumValInteger; // Filled in if tok_real
-    Operation CurrOperation;
-    OperationType CurrOpType;
-    std::string FileName;
+    Operation CurrOperation = Operation::UNKNOWN; // Filled in if tok_operator
+    OperationType CurrOpType = OperationType::BINARY;
+    unsigned FileID;
+    const char *begin;
     const char *current;
     const char *end;
+    // pre-tokenized mode
+    std::shared_ptr<const TokenBuffer> tokens;
+    size_t cursor = 0;
+    size_t lastToken = 0;
+
     int getTok();
     int NextChar();
+    void loadToken(size_t idx);
 
 };
 
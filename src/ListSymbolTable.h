@@ -17,45 +17,12 @@
 #include <string>
 #include <memory>
 #include <list>
+#include "Symbol.h"
 
 
 #ifndef SYMBOLTABLE_H
 #define	SYMBOLTABLE_H
 
-enum StorageType {
-    LOCAL = 0,
-    GLOBAL
-};
-
-template<typename SSAType>
-class Symbol {
-    std::string name;
-    SSAType memRef;
-    StorageType storageType;
-    int scope;
-public:
-
-    Symbol(std::string name, SSAType memRef, StorageType storageType, int scope) :
-    name(name), memRef(memRef), storageType(storageType), scope(scope) {
-    }
-
-    std::string& getName() {
-        return name;
-    }
-
-    SSAType getMemRef() {
-        return memRef;
-    }
-
-    int getScopeLevel() {
-        return scope;
-    }
-
-    StorageType getStorageType() {
-        return storageType;
-    };
-};
-
 template<typename SSAType>
 class ListSymbolTable {
 public:
@@ -80,7 +47,7 @@ public:
         scopeDeep--;
     }
 
-    bool contains(std::string name) {
+    bool contains(Identifier name) {
 
         for (typename std::list<Symbol<SSAType>>::iterator it = symbols.begin(); it != symbols.end(); ++it) {
             Symbol<SSAType>* symb = &(*it);
@@ -91,11 +58,11 @@ public:
         return false;
     }
 
-    StorageType getStorageType(std::string name) {
+    StorageType getStorageType(Identifier name) {
         return StorageType::LOCAL;
     }
 
-    Symbol<SSAType>* getSymbol(std::string name) {
+    Symbol<SSAType>* getSymbol(Identifier name) {
 
         for (typename std::list<Symbol<SSAType>>::iterator it = symbols.begin(); it != symbols.end(); ++it) {
             Symbol<SSAType>* symb = &(*it);
@@ -106,7 +73,7 @@ public:
         return nullptr;
     }
 
-    void insertSymbol(std::string name, StorageType storageType, SSAType menRef) {
+    void insertSymbol(Identifier name, StorageType storageType, SSAType menRef) {
 
         if (!contains(name)) {
             symbols.push_front(Symbol<SSAType>(name, menRef, storageType, scopeDeep));
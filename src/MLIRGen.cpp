@@ -16,74 +16,94 @@
 #include "mlir/IR/Module.h"
 #include "MLIRGen.h"
 
-MLIRGen::MLIRGen(mlir::MLIRContext* context) : builder(context) {
+template<template<typename> class SymbolTable>
+MLIRGen<SymbolTable>::MLIRGen(mlir::MLIRContext* context) : builder(context) {
     theModule = mlir::ModuleOp::create(builder.getUnknownLoc());
 }
 
-void MLIRGen::GenFromAST(std::unique_ptr<PrimaryAST<MLIRValue>> node) {
+template<template<typename> class SymbolTable>
+void MLIRGen<SymbolTable>::GenFromAST(std::unique_ptr<PrimaryAST<MLIRValue>> node) {
     llvm_unreachable("Unimplemented MLIRGen member function");
 }
 
-void MLIRGen::visit(PrototypeAST<MLIRValue>* node) {
+template<template<typename> class SymbolTable>
+void MLIRGen<SymbolTable>::visit(PrototypeAST<MLIRValue>* node) {
     llvm_unreachable("Unimplemented MLIRGen member function");
 }
 
-void MLIRGen::visit(FunctionAST<MLIRValue>* node) {
+template<template<typename> class SymbolTable>
+void MLIRGen<SymbolTable>::visit(FunctionAST<MLIRValue>* node) {
     llvm_unreachable("Unimplemented MLIRGen member function");
 }
 
-void MLIRGen::visit(IfExprAST<MLIRValue>* ifexp){
+template<template<typename> class SymbolTable>
+void MLIRGen<SymbolTable>::visit(IfExprAST<MLIRValue>* ifexp){
     llvm_unreachable("Unimplemented MLIRGen member function");
 }
 
-void MLIRGen::visit(ReturnAST<MLIRValue>* ifexp){
+template<template<typename> class SymbolTable>
+void MLIRGen<SymbolTable>::visit(ReturnAST<MLIRValue>* ifexp){
     llvm_unreachable("Unimplemented MLIRGen member function");
 }
 
-void MLIRGen::visit(ForExprAST<MLIRValue>* node){
+template<template<typename> class SymbolTable>
+void MLIRGen<SymbolTable>::visit(ForExprAST<MLIRValue>* node){
     llvm_unreachable("Unimplemented MLIRGen member function");
 }
 
-void MLIRGen::visit(WhileExprAST<MLIRValue>* node){
+template<template<typename> class SymbolTable>
+void MLIRGen<SymbolTable>::visit(WhileExprAST<MLIRValue>* node){
     llvm_unreachable("Unimplemented MLIRGen member function");
 }
 
-MLIRValue MLIRGen::visit(VariableExprAST<MLIRValue>* node){
+template<template<typename> class SymbolTable>
+MLIRValue MLIRGen<SymbolTable>::visit(VariableExprAST<MLIRValue>* node){
     llvm_unreachable("Unimplemented MLIRGen member function");
     return nullptr;
 }
 
-MLIRValue MLIRGen::visit(RealNumberExprAST<MLIRValue>* node){
+template<template<typename> class SymbolTable>
+MLIRValue MLIRGen<SymbolTable>::visit(RealNumberExprAST<MLIRValue>* node){
     llvm_unreachable("Unimplemented MLIRGen member function");
     return nullptr;
 }
 
-MLIRValue MLIRGen::visit(IntegerNumberExprAST<MLIRValue>* node){
+template<template<typename> class SymbolTable>
+MLIRValue MLIRGen<SymbolTable>::visit(IntegerNumberExprAST<MLIRValue>* node){
     llvm_unreachable("Unimplemented MLIRGen member function");
     return nullptr;
 }
 
-MLIRValue MLIRGen::visit(BinaryExprAST<MLIRValue>* node){
+template<template<typename> class SymbolTable>
+MLIRValue MLIRGen<SymbolTable>::visit(BinaryExprAST<MLIRValue>* node){
     llvm_unreachable("Unimplemented MLIRGen member function");
     return nullptr;
 }
 
-MLIRValue MLIRGen::visit(UnaryExprAST<MLIRValue>* node){
+template<template<typename> class SymbolTable>
+MLIRValue MLIRGen<SymbolTable>::visit(UnaryExprAST<MLIRValue>* node){
     llvm_unreachable("Unimplemented MLIRGen member function");
     return nullptr;
 }
 
-MLIRValue MLIRGen::visit(CallExprAST<MLIRValue>* node){
+template<template<typename> class SymbolTable>
+MLIRValue MLIRGen<SymbolTable>::visit(CallExprAST<MLIRValue>* node){
     llvm_unreachable("Unimplemented MLIRGen member function");
     return nullptr;
 }
 
-MLIRValue MLIRGen::visit(LocalVarDeclarationExprAST<MLIRValue>* node){
+template<template<typename> class SymbolTable>
+MLIRValue MLIRGen<SymbolTable>::visit(LocalVarDeclarationExprAST<MLIRValue>* node){
     llvm_unreachable("Unimplemented MLIRGen member function");
     return nullptr;
 }
     
-std::unique_ptr<llvm::Module> MLIRGen::getModule(){
+template<template<typename> class SymbolTable>
+std::unique_ptr<llvm::Module> MLIRGen<SymbolTable>::getModule(){
     llvm_unreachable("Unimplemented MLIRGen member function");
     return nullptr;
-}
\ No newline at end of file
+}
+
+// one generator per symbol table implementation
+template class MLIRGen<ListSymbolTable>;
+template class MLIRGen<HashSymbolTable>;
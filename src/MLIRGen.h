@@ -27,6 +27,7 @@
 #include "llvm/IR/Module.h"
 #include "AST.h"
 #include "ListSymbolTable.h"
+#include "HashSymbolTable.h"
 #include "LangDefs.h"
 #include "AbstractIRGen.h"
 
@@ -34,8 +35,10 @@ using namespace mlir;
 
 using MLIRValue = mlir::Value;
 
-// consumes the AST generating MLIR IR
+// consumes the AST generating MLIR IR, SymbolTable keeps the local variables
+// (ListSymbolTable or HashSymbolTable)
 
+template<template<typename> class SymbolTable = HashSymbolTable>
 class MLIRGen : public AbstractIRGen<MLIRValue> {
 public:
     MLIRGen(mlir::MLIRContext* context);
@@ -57,7 +60,7 @@ public:
 private:
     mlir::ModuleOp theModule;
     mlir::OpBuilder builder;
-    ListSymbolTable<MLIRValue> symbolTable;
+    SymbolTable<MLIRValue> symbolTable;
 };
 
 #endif	/* MLIRGEN_H */
@@ -18,28 +18,42 @@
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/ErrorOr.h>
 #include <llvm/Support/ErrorHandling.h>
+#include <llvm/Support/TargetSelect.h>
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <future>
+#include <thread>
+#include "BoundedQueue.h"
 #include "Parser.h"
 #include "Lexer.h"
+#include "SourceManager.h"
 #include "AST.h"
 #include "LLVMIRGen.h"
+#include "ParallelLLVMIRGen.h"
 #include "MLIRGen.h"
 #include "Optimizer.h"
 #include "Executor.h"
+#include "BytecodeGen.h"
+#include "TieredExecutor.h"
+#include "Repl.h"
+#include "Daemon.h"
+#include "BatchRunner.h"
 
 namespace cl = llvm::cl;
 using namespace std;
 
 
-static cl::opt<std::string> inputFilename(cl::Positional,
-        cl::desc("<input source file>"),
-        cl::init("nofile"),
-        cl::value_desc("filename"));
+// several files are compiled concurrently and linked by the JIT
+static cl::list<std::string> inputFilenames(cl::Positional,
+        cl::desc("<input source files>"),
+        cl::value_desc("filenames"));
 
 namespace {
 
@@ -63,16 +77,167 @@ static cl::opt<enum Action> emitAction(
         cl::values(clEnumValN(DumpAST, "ast", "output the AST dump")),
         cl::values(clEnumValN(DumpIR, "dumpir", "output the LLVM IR dump")));
 
-template<typename T>
-std::unique_ptr<Parser<T>> parseInputFile(llvm::StringRef filename) {
+static cl::opt<bool> repl("repl",
+        cl::desc("Keep the JIT alive and compile inputs from the standard input one by one, after the input files"),
+        cl::init(false));
+
+static cl::opt<std::string> daemonSocket("daemon",
+        cl::desc("Serve compile jobs on this Unix socket, with the JIT kept warm between them"),
+        cl::value_desc("socket"),
+        cl::init(""));
+
+static cl::opt<unsigned> daemonTimeout("daemon-timeout",
+        cl::desc("Seconds a daemon job may run before it is killed (0 for no limit)"),
+        cl::init(10));
+
+static cl::opt<std::string> connectSocket("connect",
+        cl::desc("Send the input file as a job to the daemon on this socket"),
+        cl::value_desc("socket"),
+        cl::init(""));
+
+static cl::opt<std::string> batchManifest("batch",
+        cl::desc("Run the scripts listed in this file, one per line, in this process"),
+        cl::value_desc("manifest"),
+        cl::init(""));
+
+static cl::opt<bool> tiered("tiered",
+        cl::desc("Start in the bytecode interpreter and promote hot functions to the JIT"),
+        cl::init(false));
+
+static cl::opt<unsigned> tierThreshold("tier-threshold",
+        cl::desc("Calls plus loop iterations before a function is promoted to the JIT"),
+        cl::init(1000));
+
+static cl::opt<bool> lazy("lazy",
+        cl::desc("Compile each function only when it is called for the first time"),
+        cl::init(false));
+
+static cl::opt<unsigned> jitThreads("jit-threads",
+        cl::desc("Number of threads compiling in parallel (0 compiles on the main thread)"),
+        cl::init(0));
+
+static cl::opt<std::string> cacheDir("cache-dir",
+        cl::desc("Keep compiled objects in this directory and reuse them in later runs"),
+        cl::value_desc("directory"),
+        cl::init(""));
+
+static cl::opt<bool> pretokenize("pretokenize",
+        cl::desc("Tokenize the whole input before parsing it"),
+        cl::init(false));
+
+static cl::opt<bool> pipelined("pipeline",
+        cl::desc("Parse on a separate thread, overlapped with IR generation (needs 2+ cores)"),
+        cl::init(false));
+
+static cl::opt<unsigned> pipelineDepth("pipeline-depth",
+        cl::desc("Parsed constructs the parser thread may run ahead of the generator"),
+        cl::init(64));
+
+static cl::opt<unsigned> parseThreads("parse-threads",
+        cl::desc("Number of threads parsing the input in parallel (0 parses it serially)"),
+        cl::init(0));
+
+static cl::opt<unsigned> irGenThreads("irgen-threads",
+        cl::desc("Number of threads generating and optimizing LLVM IR (0 uses one module)"),
+        cl::init(0));
+
+static cl::opt<char> optLevel("O",
+        cl::desc("Optimization level. [-O0, -O1, -O2, or -O3] (default = '-O2')"),
+        cl::Prefix, cl::ZeroOrMore, cl::init('2'));
+
+static unsigned getOptLevel() {
+    return optLevel - '0';
+}
+
+static cl::opt<std::string> mcpu("mcpu",
+        cl::desc("Target a specific cpu type (default = host cpu)"),
+        cl::value_desc("cpu-name"),
+        cl::init(""));
+
+static cl::list<std::string> mattrs("mattr", cl::CommaSeparated,
+        cl::desc("Target specific attributes, added to the cpu ones"),
+        cl::value_desc("+a1,-a2,..."));
+
+static cl::opt<llvm::CodeModel::Model> codeModel("code-model",
+        cl::desc("Choose the code model of the generated code"),
+        cl::values(clEnumValN(llvm::CodeModel::Tiny, "tiny", "Tiny code model")),
+        cl::values(clEnumValN(llvm::CodeModel::Small, "small", "Small code model")),
+        cl::values(clEnumValN(llvm::CodeModel::Kernel, "kernel", "Kernel code model")),
+        cl::values(clEnumValN(llvm::CodeModel::Medium, "medium", "Medium code model")),
+        cl::values(clEnumValN(llvm::CodeModel::Large, "large", "Large code model")));
+
+static cl::opt<bool> functionLayout("function-layout",
+        cl::desc("Pack hot functions together and split cold code out of them"
+            " (with -tiered, from the interpreter profile)"),
+        cl::init(false));
+
+static cl::opt<bool> pooledJITMemory("pooled-jit-memory",
+        cl::desc("Pack the code and data of all compiled modules in large shared slabs"),
+        cl::init(false));
+
+static cl::opt<bool> hugePages("huge-pages",
+        cl::desc("Back the pooled JIT memory with huge pages"),
+        cl::init(false));
+
+static cl::opt<unsigned> jitSlabSize("jit-slab-size",
+        cl::desc("Size of the pooled JIT memory slabs, in MB"),
+        cl::init(4));
+
+static cl::opt<bool> jitMemoryStats("jit-memory-stats",
+        cl::desc("Print the occupation of the pooled JIT memory at exit"),
+        cl::init(false));
+
+// JIT configuration from the command line
+static llvm::orc::JITOptions getJITOptions() {
+    llvm::orc::JITOptions options;
+    options.Lazy = lazy;
+    options.CompileThreads = jitThreads;
+    options.CacheDir = cacheDir;
+    options.PipelineConfig = Optimizer::getPipelineDescription(getOptLevel(), functionLayout);
+    options.CodeGenLevel = Optimizer::getCodeGenLevel(getOptLevel());
+    options.CPU = mcpu;
+    options.Features.assign(mattrs.begin(), mattrs.end());
+    if (codeModel.getNumOccurrences()) {
+        options.TargetCodeModel = codeModel.getValue();
+    }
+    options.PooledMemory = pooledJITMemory || hugePages;
+    options.HugePages = hugePages;
+    options.SlabSize = (size_t) jitSlabSize << 20;
+    options.PrintMemoryStats = jitMemoryStats;
+    return options;
+}
+
+static llvm::ExitOnError ExitOnErr;
+
+// The machine the JIT generates code for, so the optimizer can see it too.
+// May be called from several threads.
+static std::unique_ptr<llvm::TargetMachine> createTargetMachine() {
+    static std::once_flag nativeTargetInit;
+    std::call_once(nativeTargetInit, []() {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+    auto JTMB = ExitOnErr(llvm::orc::KaleidoscopeJIT::createTargetMachineBuilder(getJITOptions()));
+    return ExitOnErr(JTMB.createTargetMachine());
+}
+
+// Registers the input in the source manager, which keeps the buffer alive
+// for the lexer and diagnostics. Returns false if it cannot be read.
+static bool loadInputFile(llvm::StringRef filename, unsigned& FileID) {
     llvm::ErrorOr<std::unique_ptr < llvm::MemoryBuffer>> fileOrErr =
             llvm::MemoryBuffer::getFileOrSTDIN(filename);
     if (std::error_code ec = fileOrErr.getError()) {
         llvm::errs() << "Could not open input file: " << ec.message() << "\n";
-        return nullptr;
+        return false;
     }
-    auto buffer = fileOrErr.get()->getBuffer();
-    auto lexer = std::make_unique<Lexer>(buffer.begin(), buffer.end(), std::string(filename));
+    FileID = SourceManager::get().addBuffer(std::move(fileOrErr.get()), filename.str());
+    return true;
+}
+
+template<typename T>
+std::unique_ptr<Parser<T>> createParser(unsigned FileID) {
+    auto lexer = pretokenize ? std::make_unique<Lexer>(Lexer::tokenize(FileID))
+            : std::make_unique<Lexer>(FileID);
     auto parser = std::make_unique<Parser < T >> (std::move(lexer));
     return std::move(parser);
 }
@@ -80,35 +245,285 @@ std::unique_ptr<Parser<T>> parseInputFile(llvm::StringRef filename) {
 template<typename T>
 std::unique_ptr<AbstractIRGen<T>> createIRGen();
 
+// Pipelined mode: the parser runs in its own thread and hands constructs
+// over through a bounded queue, so parsing overlaps with IR generation.
 template<typename T>
-int optimizeAndRun(std::unique_ptr<T>);
+bool genFromParserPipelined(Parser<T>* parser, AbstractIRGen<T>* generator) {
+
+    BoundedQueue<std::unique_ptr<PrimaryAST<T>>> constructs(pipelineDepth ? pipelineDepth : 1);
+    bool failed = false;
+
+    std::thread parserThread([&]() {
+        while (true) {
+            auto exp = parser->nextConstruct();
+            if (parser->hasFail()) {
+                failed = true;
+                break;
+            }
+            if (!exp) {
+                break;
+            }
+            constructs.push(std::move(exp));
+        }
+        constructs.close();
+    });
+
+    std::unique_ptr<PrimaryAST<T>> exp;
+    while (constructs.pop(exp)) {
+        generator->GenFromAST(std::move(exp));
+    }
+    parserThread.join();
+
+    if (failed) {
+        llvm::errs() << "Aborting compilation\n";
+        return false;
+    }
+    return true;
+}
+
+// Feed every top level construct from the parser to the generator.
+template<typename T>
+bool genFromParser(Parser<T>* parser, AbstractIRGen<T>* generator) {
+    // with a single core the hand-offs only add overhead
+    if (pipelined && std::thread::hardware_concurrency() > 1) {
+        return genFromParserPipelined(parser, generator);
+    }
+    while (true) {
+        auto exp = parser->nextConstruct();
+        if (parser->hasFail()) {
+            llvm::errs() << "Aborting compilation\n";
+            return false;
+        }
+        if (!exp) {
+            break;
+        }
+        generator->GenFromAST(std::move(exp));
+    }
+    return true;
+}
+
+// Token indices the chunks of a file start at, about chunkSize tokens
+// apart. Chunks are only cut before top level definitions and externs, so
+// each one can be parsed on its own.
+static std::vector<size_t> splitTopLevel(const TokenBuffer& tokens, size_t chunkSize) {
+
+    std::vector<size_t> starts{0};
+    int depth = 0;
+    int previous = tok_eof;
+    for (size_t idx = 0; idx < tokens.size(); idx++) {
+        int kind = tokens.getKind(idx);
+        if (kind == '{') {
+            depth++;
+        } else if (kind == '}') {
+            depth--;
+        } else if (depth == 0 && idx - starts.back() >= chunkSize
+                && (kind == tok_function || kind == tok_extern
+                || kind == tok_inline || kind == tok_noinline)
+                && previous != tok_inline && previous != tok_noinline) {
+            starts.push_back(idx);
+        }
+        previous = kind;
+    }
+    return starts;
+}
+
+// Parallel mode: the file is tokenized up front and split in chunks of top
+// level constructs, which parseThreads threads parse with their own parser.
+// The generator takes the constructs in source order, each chunk as soon as
+// it is parsed. Locations are file offsets, so diagnostics are unaffected.
+template<typename T>
+bool genFromParallelParsers(unsigned FileID, AbstractIRGen<T>* generator) {
+
+    auto tokens = Lexer::tokenize(FileID);
+    // a few chunks per thread, to even out their sizes
+    auto starts = splitTopLevel(*tokens, tokens->size() / (parseThreads * 4) + 1);
+
+    struct Chunk {
+        std::unique_ptr<Parser<T>> parser;
+        std::vector<std::unique_ptr<PrimaryAST<T>>> constructs;
+        std::promise<void> parsed;
+    };
+    std::vector<Chunk> chunks(starts.size());
+    for (size_t i = 0; i < starts.size(); i++) {
+        size_t last = i + 1 < starts.size() ? starts[i + 1] : tokens->size();
+        chunks[i].parser = std::make_unique<Parser < T >> (
+                std::make_unique<Lexer>(tokens, starts[i], last));
+    }
+
+    std::atomic<size_t> nextChunk{0};
+    auto parseChunks = [&]() {
+        for (size_t i; (i = nextChunk++) < chunks.size();) {
+            Parser<T>* parser = chunks[i].parser.get();
+            while (true) {
+                auto exp = parser->nextConstruct();
+                if (parser->hasFail() || !exp) {
+                    break;
+                }
+                chunks[i].constructs.push_back(std::move(exp));
+            }
+            chunks[i].parsed.set_value();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < parseThreads && i < chunks.size(); i++) {
+        workers.emplace_back(parseChunks);
+    }
+
+    bool failed = false;
+    for (auto &chunk : chunks) {
+        chunk.parsed.get_future().wait();
+        // nothing after a syntax error is generated, like in serial mode
+        failed |= chunk.parser->hasFail();
+        if (!failed) {
+            for (auto &exp : chunk.constructs) {
+                generator->GenFromAST(std::move(exp));
+            }
+        }
+        chunk.constructs.clear();
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    // the parsers of the chunks own the AST the generator may still be using
+    generator->finish();
+
+    if (failed || generator->hasFail()) {
+        llvm::errs() << "Aborting compilation\n";
+        return false;
+    }
+    return true;
+}
+
+// Parse an input already in the source manager, in the mode selected on the
+// command line, and feed it to the generator.
+template<typename T>
+bool genFromSource(unsigned FileID, AbstractIRGen<T>* generator) {
+
+    if (parseThreads > 0) {
+        return genFromParallelParsers(FileID, generator);
+    }
+
+    auto parser = createParser<T>(FileID);
+    bool generated = genFromParser<T>(parser.get(), generator);
+    // the parser owns the AST the generator may still be using
+    generator->finish();
+    if (generated && generator->hasFail()) {
+        llvm::errs() << "Aborting compilation\n";
+        return false;
+    }
+    return generated;
+}
+
+template<typename T>
+bool genFromInputFile(llvm::StringRef filename, AbstractIRGen<T>* generator) {
+    unsigned FileID;
+    if (!loadInputFile(filename, FileID)) {
+        return false;
+    }
+    return genFromSource(FileID, generator);
+}
+
+// FileID is the input the generator was fed with
+template<typename T>
+int optimizeAndRun(std::unique_ptr<T>, unsigned FileID);
 
 static llvm::LLVMContext TheContext;
 
+// Optimizes one of the modules of the parallel generator, in its thread.
+static std::unique_ptr<llvm::Module> optimizeModule(llvm::LLVMContext* context,
+        std::unique_ptr<llvm::Module> module) {
+    auto TM = createTargetMachine();
+    auto optimizer = std::make_unique<Optimizer>(Optimizer(context, std::move(module),
+            getOptLevel(), TM.get()));
+    if (functionLayout) {
+        optimizer->enableFunctionLayout();
+    }
+    optimizer->optimizeCode();
+    return optimizer->getModule();
+}
+
 template<>
 std::unique_ptr<AbstractIRGen<llvm::Value*>> createIRGen<llvm::Value*>() {
-    return std::make_unique<LLVMIRGen>(&TheContext);
+    if (irGenThreads > 0) {
+        return std::make_unique<ParallelLLVMIRGen>(irGenThreads, optimizeModule);
+    }
+    return std::make_unique<LLVMIRGen<>>(&TheContext);
 }
 
 template<>
-int optimizeAndRun(std::unique_ptr<AbstractIRGen<llvm::Value*>> generator) {
-    auto optimizer = std::make_unique<Optimizer>(Optimizer(&TheContext, generator->getModule()));
+int optimizeAndRun(std::unique_ptr<AbstractIRGen<llvm::Value*>> generator, unsigned FileID) {
+    if (irGenThreads > 0) {
+        // the modules were already optimized by the generator threads
+        auto modules = static_cast<ParallelLLVMIRGen*> (generator.get())->takeModules();
+        auto executor = std::make_unique<Executor>(std::move(modules), getJITOptions());
+        executor->execute();
+        return 0;
+    }
+
+    auto TM = createTargetMachine();
+    auto optimizer = std::make_unique<Optimizer>(Optimizer(&TheContext, generator->getModule(),
+            getOptLevel(), TM.get()));
+    if (functionLayout) {
+        optimizer->enableFunctionLayout();
+    }
     optimizer->optimizeCode();
 
-    auto executor = std::make_unique<Executor>(Executor(&TheContext, optimizer->getModule()));
+    auto executor = std::make_unique<Executor>(Executor(&TheContext, optimizer->getModule(),
+            getJITOptions()));
     executor->execute();
     
     return 0;
 }
 
+// The JIT tier of the tiered mode is built from the input again, in the
+// context of the compiler thread. The source manager still has the input
+// the bytecode was generated from (stdin cannot be read twice). nullptr if
+// it cannot be built, the program then stays in the interpreter.
+static std::unique_ptr<llvm::Module> buildOptimizedModule(llvm::LLVMContext* context,
+        const FunctionCounts& profile, unsigned FileID) {
+
+    auto generator = std::make_unique<LLVMIRGen<>>(context);
+    if (!genFromSource<llvm::Value*>(FileID, generator.get())) {
+        return nullptr;
+    }
+
+    auto TM = createTargetMachine();
+    auto optimizer = std::make_unique<Optimizer>(Optimizer(context, generator->getModule(),
+            getOptLevel(), TM.get()));
+    if (functionLayout) {
+        optimizer->enableFunctionLayout(profile);
+    }
+    optimizer->optimizeCode();
+    return optimizer->getModule();
+}
+
+template<>
+std::unique_ptr<AbstractIRGen<BCValue>> createIRGen<BCValue>() {
+    return std::make_unique<BytecodeGen>();
+}
+
+template<>
+int optimizeAndRun(std::unique_ptr<AbstractIRGen<BCValue>> generator, unsigned FileID) {
+    auto bytecode = static_cast<BytecodeGen*> (generator.get())->getBytecode();
+
+    auto buildModule = [FileID](llvm::LLVMContext* context, const FunctionCounts& profile) {
+        return buildOptimizedModule(context, profile, FileID);
+    };
+    auto executor = std::make_unique<TieredExecutor>(std::move(bytecode),
+            buildModule, tierThreshold, getJITOptions());
+    executor->execute();
+
+    return 0;
+}
+
 mlir::MLIRContext TheMLIRContext;
 
 template<>
 std::unique_ptr<AbstractIRGen<mlir::Value>> createIRGen<mlir::Value>() {
-    return std::make_unique<MLIRGen>(&TheMLIRContext);
+    return std::make_unique<MLIRGen<>>(&TheMLIRContext);
 }
 template<>
-int optimizeAndRun(std::unique_ptr<AbstractIRGen<mlir::Value>> generator) {
+int optimizeAndRun(std::unique_ptr<AbstractIRGen<mlir::Value>> generator, unsigned FileID) {
     llvm_unreachable("Uimplemented optimizeAndRun for MLIR");
     return 0;
 }
@@ -124,38 +539,173 @@ int dumpAST() {
 
 template<typename T>
 int GenDriver() {
-    
-    if(inputFilename == "nofile"){
-        llvm::errs() << "Interpreter error: no input file\n";
+
+    auto generator = createIRGen<T>();
+
+    unsigned FileID;
+    if (!loadInputFile(inputFilenames[0], FileID) || !genFromSource<T>(FileID, generator.get())) {
         return -1;
     }
-
-    auto parser = parseInputFile<T>(inputFilename);
     
-    if(parser == nullptr){
-        return 1;
+    return optimizeAndRun(std::move(generator), FileID);
+}
+
+// Compiles one of several input files into optimized modules, each one in
+// its own context. Externs are resolved against the other files by the JIT.
+static bool compileFile(const std::string& filename,
+        std::vector<llvm::orc::ThreadSafeModule>& modules) {
+
+    if (irGenThreads > 0) {
+        ParallelLLVMIRGen generator(irGenThreads, optimizeModule);
+        if (!genFromInputFile<llvm::Value*>(filename, &generator)) {
+            return false;
+        }
+        modules = generator.takeModules();
+    } else {
+        auto context = std::make_unique<llvm::LLVMContext>();
+        LLVMIRGen<> generator(context.get());
+        if (!genFromInputFile<llvm::Value*>(filename, &generator)) {
+            return false;
+        }
+        auto module = optimizeModule(context.get(), generator.getModule());
+        modules.emplace_back(std::move(module), std::move(context));
     }
-    
-    auto generator = createIRGen<T>();
+    // the name keeps modules apart in the object cache and in diagnostics
+    for (auto &TSM : modules) {
+        TSM.withModuleDo([&filename](llvm::Module & M) {
+            M.setModuleIdentifier(filename); });
+    }
+    return true;
+}
 
-    while (true) {
-        auto exp = parser->nextConstruct();
-        if (parser->hasFail()) {
-            llvm::errs() << "Aborting compilation\n";
+// Multi-file mode: the files are compiled concurrently, up to one per core,
+// then the JIT links them and runs main.
+static int MultiFileDriver() {
+
+    std::vector<std::vector<llvm::orc::ThreadSafeModule>> fileModules(inputFilenames.size());
+    std::vector<char> compiled(inputFilenames.size(), false);
+
+    std::atomic<size_t> nextFile{0};
+    auto compileFiles = [&]() {
+        for (size_t i; (i = nextFile++) < inputFilenames.size();) {
+            compiled[i] = compileFile(inputFilenames[i], fileModules[i]);
+        }
+    };
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < threads && i < inputFilenames.size(); i++) {
+        workers.emplace_back(compileFiles);
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    std::vector<llvm::orc::ThreadSafeModule> modules;
+    for (size_t i = 0; i < inputFilenames.size(); i++) {
+        if (!compiled[i]) {
+            llvm::errs() << "Interpreter error: compilation of " << inputFilenames[i] << " failed\n";
             return -1;
         }
-        if (!exp) {
-            break;
+        for (auto &TSM : fileModules[i]) {
+            modules.push_back(std::move(TSM));
         }
-        generator->GenFromAST(std::move(exp));
     }
-    
-    return optimizeAndRun(std::move(generator));
+
+    auto executor = std::make_unique<Executor>(std::move(modules), getJITOptions());
+    executor->execute();
+    return 0;
+}
+
+static JITCompilerOptions getJITCompilerOptions() {
+    JITCompilerOptions options;
+    options.OptLevel = getOptLevel();
+    options.CPU = mcpu;
+    options.Features.assign(mattrs.begin(), mattrs.end());
+    options.CacheDir = cacheDir;
+    options.PooledMemory = pooledJITMemory || hugePages;
+    options.HugePages = hugePages;
+    options.LayoutFunctions = functionLayout;
+    return options;
+}
+
+static int DaemonDriver() {
+    Daemon daemon(getJITCompilerOptions(), daemonTimeout);
+    return daemon.serve(daemonSocket);
+}
+
+static int BatchDriver() {
+    BatchRunner runner(getJITCompilerOptions());
+    return runner.run(batchManifest);
+}
+
+static int ClientDriver() {
+    auto fileOrErr = llvm::MemoryBuffer::getFile(inputFilenames[0]);
+    if (std::error_code ec = fileOrErr.getError()) {
+        llvm::errs() << "Could not open input file: " << ec.message() << "\n";
+        return -1;
+    }
+    return Daemon::submit(connectSocket, fileOrErr.get()->getBuffer().str());
+}
+
+// Incremental mode: the input files are loaded into the session first.
+static int ReplDriver() {
+
+    Repl session(getJITOptions(), getOptLevel());
+    for (auto &filename : inputFilenames) {
+        auto fileOrErr = llvm::MemoryBuffer::getFile(filename);
+        if (std::error_code ec = fileOrErr.getError()) {
+            llvm::errs() << "Could not open input file: " << ec.message() << "\n";
+            return -1;
+        }
+        if (!session.eval(fileOrErr.get()->getBuffer(), filename)) {
+            return -1;
+        }
+    }
+    session.run(std::cin);
+    return 0;
 }
 
 int main(int argc, char **argv) {
     cl::ParseCommandLineOptions(argc, argv, "jit compiler\n");
 
+    if (optLevel < '0' || optLevel > '3') {
+        llvm::errs() << "Interpreter error: invalid optimization level -O" << optLevel << "\n";
+        return -1;
+    }
+
+    if (repl) {
+        return ReplDriver();
+    }
+
+    if (!daemonSocket.empty()) {
+        return DaemonDriver();
+    }
+
+    if (!batchManifest.empty()) {
+        return BatchDriver();
+    }
+
+    if (inputFilenames.empty()) {
+        llvm::errs() << "Interpreter error: no input file\n";
+        return -1;
+    }
+
+    if (!connectSocket.empty()) {
+        return ClientDriver();
+    }
+
+    if (inputFilenames.size() > 1) {
+        if (tiered || irType != IrType::LLVMIR) {
+            llvm::errs() << "Interpreter error: several input files are only supported by the LLVM IR JIT\n";
+            return -1;
+        }
+        return MultiFileDriver();
+    }
+
+    if (tiered) {
+        return GenDriver<BCValue>();
+    }
+
     switch (irType) {
         case IrType::LLVMIR:
             return GenDriver<llvm::Value*>();
@@ -16,40 +16,118 @@
 
 #include "Optimizer.h"
 #include <llvm/IR/Verifier.h>
-#include "llvm/Transforms/InstCombine/InstCombine.h"
-#include "llvm/Transforms/Scalar.h"
-#include "llvm/Transforms/Scalar/GVN.h"
-#include "llvm/Transforms/Utils.h"
-
-void Optimizer::InitializePassManager() {
-    //TheModule->setDataLayout(TheJIT->getTargetMachine().createDataLayout());
-    TheFPM = std::make_unique<legacy::FunctionPassManager>(TheModule.get());
-    // Create a new pass manager attached to it.
-
-    // Promote allocas to registers.
-    TheFPM->add(createPromoteMemoryToRegisterPass());
-    // Do simple "peephole" optimizations and bit-twiddling optzns.
-    TheFPM->add(createInstructionCombiningPass());
-    // Reassociate expressions.
-    TheFPM->add(createReassociatePass());
-    // Eliminate Common SubExpressions.
-    TheFPM->add(createGVNPass());
-    // Simplify the control flow graph (deleting unreachable blocks, etc).
-    TheFPM->add(createCFGSimplificationPass());
-
-    TheFPM->doInitialization();
+#include <llvm/Transforms/IPO/AlwaysInliner.h>
+#include <llvm/Transforms/IPO/HotColdSplitting.h>
+
+PassBuilder::OptimizationLevel Optimizer::getLevel(unsigned OptLevel) {
+    switch (OptLevel) {
+        case 1:
+            return PassBuilder::OptimizationLevel::O1;
+        case 2:
+            return PassBuilder::OptimizationLevel::O2;
+        default:
+            return PassBuilder::OptimizationLevel::O3;
+    }
+}
+
+void Optimizer::enableFunctionLayout(FunctionCounts Profile) {
+    Layout = std::make_unique<FunctionLayout>(std::move(Profile));
 }
 
+// Runs the default module pipeline of the new pass manager for the level:
+// inlining, SROA, LICM, loop unrolling and the vectorizers among others.
+// Tail recursion elimination (with accumulator introduction, e.g. for
+// "return n * f(n - 1)") is part of the function simplification pipeline.
 
 void Optimizer::optimizeCode() {
 
+    if (TM) {
+        TheModule->setDataLayout(TM->createDataLayout());
+        TheModule->setTargetTriple(TM->getTargetTriple().str());
+    }
+
     for (auto &Func : TheModule->getFunctionList()) {
-        //Func.print(errs());
-       
         verifyFunction(Func, &errs());
-        TheFPM->run(Func);
-        //Func.print(errs());
-        
+    }
+
+    // -O0 leaves the IR as generated, for the lowest compile latency, only
+    // functions marked 'inline' in the source are still inlined
+    if (OptLevel == 0) {
+        runAlwaysInliner();
+        return;
+    }
+
+    if (Layout) {
+        Layout->annotate(*TheModule);
+    }
+
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+
+    // the vectorizers are off by default, clang enables them from -O2
+    PipelineTuningOptions PTO;
+    PTO.LoopVectorization = OptLevel >= 2;
+    PTO.SLPVectorization = OptLevel >= 2;
+
+    PassBuilder PB(TM, PTO);
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    ModulePassManager MPM = PB.buildPerModuleDefaultPipeline(getLevel(OptLevel));
+    if (Layout) {
+        MPM.addPass(HotColdSplittingPass());
+    }
+    MPM.run(*TheModule, MAM);
+
+    if (Layout) {
+        Layout->arrange(*TheModule);
+    }
+}
+
+void Optimizer::runAlwaysInliner() {
+
+    bool hasAlwaysInline = false;
+    for (auto &Func : *TheModule) {
+        hasAlwaysInline |= Func.hasFnAttribute(Attribute::AlwaysInline);
+    }
+    if (!hasAlwaysInline) {
+        return;
+    }
+
+    ModuleAnalysisManager MAM;
+    PassBuilder PB;
+    PB.registerModuleAnalyses(MAM);
+
+    ModulePassManager MPM;
+    MPM.addPass(AlwaysInlinerPass());
+    MPM.run(*TheModule, MAM);
+}
+
+std::string Optimizer::getPipelineDescription(unsigned OptLevel, bool Layout) {
+    if (OptLevel == 0) {
+        return "none";
+    }
+    std::string Description = "default<O" + std::to_string(OptLevel > 3 ? 3 : OptLevel) + ">";
+    // the layout follows the profile of the run that compiled the object,
+    // cached objects keep it
+    return Layout ? Description + ",hotcoldsplit,function-layout" : Description;
+}
+
+CodeGenOpt::Level Optimizer::getCodeGenLevel(unsigned OptLevel) {
+    switch (OptLevel) {
+        case 0:
+            return CodeGenOpt::None;
+        case 1:
+            return CodeGenOpt::Less;
+        case 2:
+            return CodeGenOpt::Default;
+        default:
+            return CodeGenOpt::Aggressive;
     }
 }
 
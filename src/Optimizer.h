@@ -27,27 +27,43 @@
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
-#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Target/TargetMachine.h>
 #include <memory>
+#include <string>
+#include "FunctionLayout.h"
 
 using namespace llvm;
 
 class Optimizer {
 public:
 
-    Optimizer(LLVMContext* TheContext, std::unique_ptr<Module>&& TheModule) :
-    TheContext(TheContext), TheModule(std::move(TheModule)) {
-        InitializePassManager();
+    // OptLevel goes from 0 (no optimization at all) to 3, like -O0..-O3.
+    // With a target machine, the passes use its cost model (e.g. the vector
+    // width of the vectorizers) and the module gets its data layout.
+    Optimizer(LLVMContext* TheContext, std::unique_ptr<Module>&& TheModule,
+            unsigned OptLevel = 2, TargetMachine* TM = nullptr) :
+    TheModule(std::move(TheModule)), TheContext(TheContext), OptLevel(OptLevel), TM(TM) {
     }
 
+    // Packs the hot functions together and splits cold code out of them,
+    // see FunctionLayout. Without a profile the heat is estimated. Not at -O0.
+    void enableFunctionLayout(FunctionCounts Profile = FunctionCounts());
     void optimizeCode();
     std::unique_ptr<Module> getModule();
+    // passes run by optimizeCode(), used to key cached objects
+    static std::string getPipelineDescription(unsigned OptLevel, bool Layout = false);
+    // code generator level matching OptLevel, for the JIT
+    static CodeGenOpt::Level getCodeGenLevel(unsigned OptLevel);
 private:
-    std::unique_ptr<legacy::FunctionPassManager> TheFPM;
     std::unique_ptr<Module> TheModule;
     LLVMContext* TheContext;
+    unsigned OptLevel;
+    TargetMachine* TM;
+    std::unique_ptr<FunctionLayout> Layout;
 
-    void InitializePassManager();
+    void runAlwaysInliner();
+    static PassBuilder::OptimizationLevel getLevel(unsigned OptLevel);
 };
 
 #endif	/* JIT_H */
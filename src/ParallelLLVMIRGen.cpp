@@ -0,0 +1,199 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <cstdio>
+#include <cstdlib>
+#include "llvm/Support/ErrorHandling.h"
+#include "ParallelLLVMIRGen.h"
+
+// functions queued per worker, enough to keep them busy
+static const size_t QueueDepth = 16;
+
+static void LogError(const char *Str, std::string msg, std::string loc) {
+    printf("Code generator error: %s (%s) -> %s\n", Str, msg.c_str(), loc.c_str());
+}
+
+ParallelLLVMIRGen::ParallelLLVMIRGen(unsigned threads, ModuleFinisher Finish) :
+Finish(std::move(Finish)), work(QueueDepth * (threads ? threads : 1)) {
+
+    for (unsigned i = 0; i < (threads ? threads : 1); i++) {
+        workers.push_back(std::make_unique<Worker>());
+        Worker* worker = workers.back().get();
+        worker->thread = std::thread([this, worker]() {
+            run(*worker); });
+    }
+}
+
+ParallelLLVMIRGen::~ParallelLLVMIRGen() {
+    finish();
+}
+
+// Main thread: record the prototypes in source order and queue the
+// definitions for the workers.
+
+void ParallelLLVMIRGen::GenFromAST(std::unique_ptr<PrimaryAST<LLVMValue>> node) {
+    // like LLVMIRGen, nothing is generated after an error
+    if (failed) {
+        return;
+    }
+    current = std::move(node);
+    current->acceptIRGenVisitor(this);
+    current.reset();
+}
+
+void ParallelLLVMIRGen::visit(PrototypeAST<LLVMValue>* node) {
+    // an extern only declares, workers pick it up from the signatures
+    addSignature(node);
+}
+
+void ParallelLLVMIRGen::visit(FunctionAST<LLVMValue>* node) {
+
+    if (!defined.insert(node->getName()).second) {
+        LogError("Function already defined", node->getName().str(),
+                node->getDebugInfo()->getInfo());
+        failed = true;
+        return;
+    }
+    // the prototype stays in the node, the worker finds it declared
+    addSignature(node->peekProto());
+
+    WorkItem item;
+    item.visible = signatures.size();
+    item.node = std::move(current);
+    work.push(std::move(item));
+}
+
+void ParallelLLVMIRGen::addSignature(PrototypeAST<LLVMValue>* proto) {
+    std::lock_guard<std::mutex> lock(signaturesMutex);
+    signatures.push_back({proto->getName(), proto->getReturnType(), proto->getArgs()});
+}
+
+// Worker thread: generate the queued definitions, then finish the module.
+
+void ParallelLLVMIRGen::run(Worker& worker) {
+
+    worker.context = std::make_unique<LLVMContext>();
+    worker.generator = std::make_unique<LLVMIRGen<>>(worker.context.get());
+
+    WorkItem item;
+    while (work.pop(item)) {
+        // declare what the function can see, a deque does not move its elements
+        std::vector<FunctionSignature*> visible;
+        {
+            std::lock_guard<std::mutex> lock(signaturesMutex);
+            for (; worker.declared < item.visible; worker.declared++) {
+                visible.push_back(&signatures[worker.declared]);
+            }
+        }
+        for (FunctionSignature* signature : visible) {
+            worker.generator->declareFunction(*signature);
+        }
+        worker.generator->GenFromAST(std::move(item.node));
+    }
+
+    worker.failed = worker.generator->hasFail();
+    worker.module = Finish(worker.context.get(), worker.generator->getModule());
+    worker.generator.reset();
+}
+
+void ParallelLLVMIRGen::finish() {
+    if (finished) {
+        return;
+    }
+    finished = true;
+    work.close();
+    for (auto &worker : workers) {
+        worker->thread.join();
+    }
+}
+
+bool ParallelLLVMIRGen::hasFail() {
+
+    finish();
+    for (auto &worker : workers) {
+        if (worker->failed) {
+            return true;
+        }
+    }
+    return failed;
+}
+
+std::vector<orc::ThreadSafeModule> ParallelLLVMIRGen::takeModules() {
+
+    finish();
+    std::vector<orc::ThreadSafeModule> modules;
+    for (auto &worker : workers) {
+        if (!worker->module) {
+            continue;
+        }
+        bool hasDefinitions = false;
+        for (auto &F : *worker->module) {
+            hasDefinitions |= !F.isDeclaration();
+        }
+        if (hasDefinitions) {
+            modules.emplace_back(std::move(worker->module), std::move(worker->context));
+        }
+    }
+    return modules;
+}
+
+std::unique_ptr<Module> ParallelLLVMIRGen::getModule() {
+    llvm_unreachable("ParallelLLVMIRGen generates one module per thread, use takeModules");
+}
+
+// Only top level constructs reach this generator, the workers visit the rest.
+
+void ParallelLLVMIRGen::visit(IfExprAST<LLVMValue>* node) {
+    llvm_unreachable("Expression visited by ParallelLLVMIRGen");
+}
+
+void ParallelLLVMIRGen::visit(ReturnAST<LLVMValue>* node) {
+    llvm_unreachable("Expression visited by ParallelLLVMIRGen");
+}
+
+void ParallelLLVMIRGen::visit(ForExprAST<LLVMValue>* node) {
+    llvm_unreachable("Expression visited by ParallelLLVMIRGen");
+}
+
+void ParallelLLVMIRGen::visit(WhileExprAST<LLVMValue>* node) {
+    llvm_unreachable("Expression visited by ParallelLLVMIRGen");
+}
+
+llvm::Value* ParallelLLVMIRGen::visit(VariableExprAST<LLVMValue>* node) {
+    llvm_unreachable("Expression visited by ParallelLLVMIRGen");
+}
+
+llvm::Value* ParallelLLVMIRGen::visit(RealNumberExprAST<LLVMValue>* node) {
+    llvm_unreachable("Expression visited by ParallelLLVMIRGen");
+}
+
+llvm::Value* ParallelLLVMIRGen::visit(IntegerNumberExprAST<LLVMValue>* node) {
+    llvm_unreachable("Expression visited by ParallelLLVMIRGen");
+}
+
+llvm::Value* ParallelLLVMIRGen::visit(BinaryExprAST<LLVMValue>* node) {
+    llvm_unreachable("Expression visited by ParallelLLVMIRGen");
+}
+
+llvm::Value* ParallelLLVMIRGen::visit(UnaryExprAST<LLVMValue>* node) {
+    llvm_unreachable("Expression visited by ParallelLLVMIRGen");
+}
+
+llvm::Value* ParallelLLVMIRGen::visit(CallExprAST<LLVMValue>* node) {
+    llvm_unreachable("Expression visited by ParallelLLVMIRGen");
+}
+
+llvm::Value* ParallelLLVMIRGen::visit(LocalVarDeclarationExprAST<LLVMValue>* node) {
+    llvm_unreachable("Expression visited by ParallelLLVMIRGen");
+}
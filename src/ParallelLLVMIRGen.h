@@ -0,0 +1,108 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef PARALLELLLVMIRGEN_H
+#define	PARALLELLLVMIRGEN_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "BoundedQueue.h"
+#include "LLVMIRGen.h"
+
+/// Generates LLVM IR on several threads. Function definitions arrive in
+/// source order and are handed to workers, each one with its own context,
+/// module and LLVMIRGen. Before generating a function a worker declares the
+/// prototypes that precede it in the source, so the same calls as in serial
+/// mode are accepted. Every worker then finishes its module (e.g. runs the
+/// optimizer on it) and the modules are linked by the JIT.
+
+class ParallelLLVMIRGen : public AbstractIRGen<LLVMValue> {
+public:
+    // runs in the worker thread over its module, e.g. to optimize it
+    using ModuleFinisher = std::function<std::unique_ptr<Module>(LLVMContext*,
+            std::unique_ptr<Module>)>;
+
+    ParallelLLVMIRGen(unsigned threads, ModuleFinisher Finish);
+    ~ParallelLLVMIRGen();
+
+    virtual void GenFromAST(std::unique_ptr<PrimaryAST<LLVMValue>> node) override;
+    virtual void visit(PrototypeAST<LLVMValue>* node) override;
+    virtual void visit(FunctionAST<LLVMValue>* node) override;
+    virtual void visit(IfExprAST<LLVMValue>* ifexp) override;
+    virtual void visit(ReturnAST<LLVMValue>* ifexp) override;
+    virtual void visit(ForExprAST<LLVMValue>* node) override;
+    virtual void visit(WhileExprAST<LLVMValue>* node) override;
+    virtual llvm::Value* visit(VariableExprAST<LLVMValue>* node) override;
+    virtual llvm::Value* visit(RealNumberExprAST<LLVMValue>* node) override;
+    virtual llvm::Value* visit(IntegerNumberExprAST<LLVMValue>* node) override;
+    virtual llvm::Value* visit(BinaryExprAST<LLVMValue>* node) override;
+    virtual llvm::Value* visit(UnaryExprAST<LLVMValue>* node) override;
+    virtual llvm::Value* visit(CallExprAST<LLVMValue>* node) override;
+    virtual llvm::Value* visit(LocalVarDeclarationExprAST<LLVMValue>* node) override;
+    // there is no single module, see takeModules
+    virtual std::unique_ptr<Module> getModule() override;
+    // joins the workers, GenFromAST cannot be called anymore
+    virtual void finish() override;
+    // waits for the workers, their errors are only known then
+    virtual bool hasFail() override;
+
+    // Waits for the workers and returns the modules with some definition,
+    // each one with its context.
+    std::vector<orc::ThreadSafeModule> takeModules();
+
+private:
+
+    struct WorkItem {
+        std::unique_ptr<PrimaryAST<LLVMValue>> node;
+        // prototypes declared before it in the source
+        size_t visible;
+    };
+
+    struct Worker {
+        std::unique_ptr<LLVMContext> context;
+        std::unique_ptr<LLVMIRGen<>> generator;
+        size_t declared = 0;
+        bool failed = false;
+        std::unique_ptr<Module> module;
+        std::thread thread;
+    };
+
+    ModuleFinisher Finish;
+    BoundedQueue<WorkItem> work;
+    std::vector<std::unique_ptr<Worker>> workers;
+    bool finished = false;
+    // a function defined twice
+    bool failed = false;
+
+    // prototypes in source order; only appended to, under signaturesMutex
+    std::deque<FunctionSignature> signatures;
+    std::mutex signaturesMutex;
+    std::unordered_set<Identifier> defined;
+    // the construct being visited by GenFromAST
+    std::unique_ptr<PrimaryAST<LLVMValue>> current;
+
+    void addSignature(PrototypeAST<LLVMValue>* proto);
+    void run(Worker& worker);
+};
+
+#endif	/* PARALLELLLVMIRGEN_H */
+
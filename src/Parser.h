@@ -17,14 +17,10 @@
 #ifndef PARSER_H
 #define	PARSER_H
 #include <memory>
+#include <vector>
 #include "Lexer.h"
 #include "AST.h"
 
-static void abort(std::string str, int line) {
-    std::cout << str << " at line: " << line << std::endl;
-    exit(-1);
-}
-
 template <class T>
 static std::unique_ptr<T> LogError(const char *Str, std::string loc) {
     fprintf(stderr, "Compiler error (parser): %s -> %s\n", Str, loc.c_str());
@@ -35,7 +31,7 @@ static void LogWarn(const char *Str, std::string loc) {
     fprintf(stderr, "Compiler warning (parser): %s -> %s\n", Str, loc.c_str());
 }
 
-static VarType convertType(std::string& type) {
+static VarType convertType(const std::string& type) {
 
     VarType t;
 
@@ -51,7 +47,7 @@ static VarType convertType(std::string& type) {
     return t;
 }
 
-static Arg createArg(std::string& type, std::string& name) {
+static Arg createArg(const std::string& type, Identifier name) {
 
     VarType t = convertType(type);
 
@@ -73,11 +69,16 @@ public:
     //Parser(const Parser& orig) { std::cout << "teste";};
     //virtual ~Parser() {};
 
+    // The returned construct lives in an arena of the parser, so it must not
+    // outlive it. Arenas are recycled here once their constructs are gone.
+
     std::unique_ptr<PrimaryAST<T>> nextConstruct() {
         //while (lexer->getCurrentToken() == ';') {
         //lexer->getNextToken();
         //}
 
+        ASTArena::Scope scope(recycleArena());
+
         switch (lexer->getCurrentToken()) {
             case tok_eof:
                 return nullptr;
@@ -85,14 +86,19 @@ public:
             case tok_function:
                 return ParseDefinition();
                 break;
+            case tok_inline:
+            case tok_noinline:
+                return ParseAttributedDefinition();
+                break;
             case tok_extern:
                 lexer->getNextToken();
                 return ParsePrototype(true);
                 break;
             default:
                 //HandleTopLevelExpression();
-                abort("Unknown token: " + lexer->getIdentifierStr(), 0);
-                break;
+                fail();
+                return LogError<PrimaryAST < T >> ("Unknown token at top level",
+                        genDebugInfo()->getInfo());
         }
         return nullptr;
     }
@@ -102,19 +108,58 @@ public:
     }
 private:
     std::unique_ptr<Lexer> lexer;
+    // Constructs still in use (e.g. queued for the generator thread) keep
+    // their arena from being recycled, parsing moves on to another arena
+    // once the current one is this big.
+    static const size_t ArenaRotateSize = 1 << 20;
+    std::vector<std::unique_ptr<ASTArena>> arenas;
+    ASTArena* arena = nullptr;
+
+    ASTArena& recycleArena() {
+        if (arena) {
+            arena->reset();
+            if (arena->getBytesAllocated() < ArenaRotateSize) {
+                return *arena;
+            }
+        }
+        for (auto &candidate : arenas) {
+            if (candidate->isIdle()) {
+                candidate->reset();
+                return *(arena = candidate.get());
+            }
+        }
+        arenas.push_back(std::make_unique<ASTArena>());
+        return *(arena = arenas.back().get());
+    }
 
     std::unique_ptr<DebugInfo> genDebugInfo() {
-        return std::make_unique<DebugInfo>(DebugInfo(lexer->GetTokLine(), lexer->GetTokCol(), lexer->getFileName(), lexer->getLineStr()));
+        return std::make_unique<DebugInfo>(lexer->getFileID(), lexer->GetTokOffset());
+
+    }
+
+    /// attributeddefinition ::= ('inline' | 'noinline') definition
 
+    std::unique_ptr<FunctionAST<T>> ParseAttributedDefinition() {
+        InlineHint hint = lexer->getCurrentToken() == tok_inline ? INLINE_ALWAYS : INLINE_NEVER;
+        auto DI = genDebugInfo();
+        lexer->getNextToken(); // eat the attribute.
+
+        if (lexer->getCurrentToken() != tok_function) {
+            fail();
+            return LogError<FunctionAST < T >> ("Expected function definition after inline attribute",
+                    DI->getInfo());
+        }
+        return ParseDefinition(hint);
     }
 
     /// definition ::= 'def' prototype expression
 
-    std::unique_ptr<FunctionAST<T>> ParseDefinition() {
+    std::unique_ptr<FunctionAST<T>> ParseDefinition(InlineHint hint = INLINE_DEFAULT) {
         lexer->getNextToken(); // eat def.
         auto DI = genDebugInfo();
         auto Proto = ParsePrototype(false);
         if (!Proto) return nullptr;
+        Proto->setInlineHint(hint);
 
         if (lexer->getCurrentToken() != '{') {
             fail();
@@ -177,7 +222,7 @@ private:
                     DI->getInfo());
         }
 
-        std::string FnName = lexer->getIdentifierStr();
+        Identifier FnName = lexer->getIdentifier();
         //std::cout << FnName << std::endl;
         lexer->getNextToken();
 
@@ -200,8 +245,7 @@ private:
                 return LogError<PrototypeAST < T >> ("Expected parameter name after type in prototype",
                         DI->getInfo());
             }
-            std::string name = lexer->getIdentifierStr();
-            ArgNames.push_back(createArg(type, name));
+            ArgNames.push_back(createArg(type, lexer->getIdentifier()));
             lexer->getNextToken();
             if (lexer->getCurrentToken() == ',') {
                 lexer->getNextToken();
@@ -309,7 +353,7 @@ private:
     std::unique_ptr<ExprAST<T>> ParseIdentifierExpr() {
 
         auto DI = genDebugInfo();
-        std::string IdName = lexer->getIdentifierStr();
+        Identifier IdName = lexer->getIdentifier();
         std::unique_ptr<ExprAST < T>> exp;
         lexer->getNextToken(); // eat identifier.
         if (lexer->getCurrentToken() != '(') { // Simple variable ref.
@@ -677,7 +721,7 @@ private:
                     DI->getInfo());
         }
 
-        std::string Name = lexer->getIdentifierStr();
+        Identifier Name = lexer->getIdentifier();
         lexer->getNextToken(); // eat identifier
 
         if (lexer->getCurrentToken() == tok_operator && lexer->getOperation() == Operation::ASSIGN) {
@@ -0,0 +1,286 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <algorithm>
+#include <iostream>
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TargetSelect.h"
+#include "Lexer.h"
+#include "Optimizer.h"
+#include "Parser.h"
+#include "Repl.h"
+#include "SourceManager.h"
+
+static ExitOnError ExitOnErr;
+
+// Statements are wrapped in a function with this name, renamed to
+// AnonPrefix + input number once generated (a name sources cannot use).
+static const Identifier AnonName("replinput");
+static const char* AnonPrefix = "__repl_";
+
+static bool sameTypes(FunctionSignature& a, FunctionSignature& b) {
+    if (a.returnType != b.returnType || a.args.size() != b.args.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.args.size(); i++) {
+        if (a.args[i].getType() != b.args[i].getType()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void logError(Error Err) {
+    logAllUnhandledErrors(std::move(Err), errs(), "JIT error: ");
+}
+
+Repl::Repl(JITOptions Options, unsigned OptLevel) : OptLevel(OptLevel) {
+
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+    InitializeNativeTargetAsmParser();
+    TheJIT = ExitOnErr(KaleidoscopeJIT::Create(Options));
+    auto JTMB = ExitOnErr(KaleidoscopeJIT::createTargetMachineBuilder(Options));
+    TM = ExitOnErr(JTMB.createTargetMachine());
+    Stubs = createLocalIndirectStubsManagerBuilder(TheJIT->getTargetTriple())();
+}
+
+std::string Repl::getBodyName(Identifier name, unsigned version) {
+    return name.str() + "$" + std::to_string(version);
+}
+
+// Returns true if the input holds statements. Otherwise collects the
+// functions it defines.
+
+bool Repl::scanInput(unsigned FileID, std::vector<Identifier>& defined) {
+
+    auto tokens = Lexer::tokenize(FileID);
+    int first = tokens->getKind(0);
+    if (first != tok_function && first != tok_extern && first != tok_inline
+            && first != tok_noinline && first != tok_eof) {
+        return true;
+    }
+
+    int depth = 0;
+    for (size_t idx = 0; idx + 2 < tokens->size(); idx++) {
+        int kind = tokens->getKind(idx);
+        if (kind == '{') {
+            depth++;
+        } else if (kind == '}') {
+            depth--;
+        } else if (depth == 0 && kind == tok_function
+                && tokens->getKind(idx + 2) == tok_identifier) {
+            defined.push_back(tokens->getIdentifier(idx + 2));
+        }
+    }
+    return false;
+}
+
+bool Repl::eval(StringRef source, StringRef name) {
+
+    unsigned input = ++inputs;
+    unsigned FileID = SourceManager::get().addBuffer(
+            MemoryBuffer::getMemBufferCopy(source, name), name.str());
+    // only needed while parsing and generating code
+    ScopedSourceBuffer buffer(FileID);
+
+    std::vector<Identifier> defined;
+    std::string anonName;
+    if (scanInput(FileID, defined)) {
+        anonName = AnonPrefix + std::to_string(input);
+        defined.push_back(AnonName);
+        // on the first line, so diagnostics keep their line numbers
+        std::string wrapped = "function none " + AnonName.str() + "() { " + source.str() + "\n}";
+        FileID = SourceManager::get().addBuffer(
+                MemoryBuffer::getMemBufferCopy(wrapped, name), name.str());
+        buffer.reset(FileID);
+    }
+
+    auto context = std::make_unique<LLVMContext>();
+    LLVMIRGen<> generator(context.get());
+    // redefined functions take their signature from the input
+    for (auto &entry : signatures) {
+        if (std::find(defined.begin(), defined.end(), entry.first) == defined.end()) {
+            generator.declareFunction(entry.second);
+        }
+    }
+
+    Parser<LLVMValue> parser(std::make_unique<Lexer>(FileID));
+    while (true) {
+        auto exp = parser.nextConstruct();
+        if (parser.hasFail()) {
+            errs() << "Input discarded\n";
+            return false;
+        }
+        if (!exp) {
+            break;
+        }
+        generator.GenFromAST(std::move(exp));
+    }
+    if (generator.hasFail()) {
+        errs() << "Input discarded\n";
+        return false;
+    }
+
+    std::unique_ptr<Module> module = generator.getModule();
+    module->setModuleIdentifier(name);
+    if (!anonName.empty()) {
+        module->getFunction(AnonName.str())->setName(anonName);
+    }
+
+    // callers compiled before a redefinition still pass the old arguments
+    for (auto &F : *module) {
+        if (F.getName() == anonName) {
+            continue;
+        }
+        FunctionSignature signature = getFunctionSignature(F);
+        auto previous = signatures.find(signature.name);
+        if (previous != signatures.end() && !sameTypes(previous->second, signature)) {
+            errs() << "Redefinition of " << F.getName() << " with another signature, input discarded\n";
+            return false;
+        }
+    }
+
+    // Bodies get a versioned name and everything in the module, the body
+    // itself included, calls the function through its stub: a declaration
+    // under the function name, resolved to the stub by the JIT.
+    std::vector<FunctionSignature> declared;
+    std::vector<Function*> definitions;
+    for (auto &F : *module) {
+        if (F.getName() == anonName) {
+            continue;
+        }
+        declared.push_back(getFunctionSignature(F));
+        if (!F.isDeclaration()) {
+            definitions.push_back(&F);
+        }
+    }
+    std::vector<std::pair<Identifier, unsigned>> bodies;
+    for (Function* F : definitions) {
+        Identifier functionName(F->getName().str());
+        auto current = versions.find(functionName);
+        unsigned version = (current != versions.end() ? current->second : 0) + 1;
+        Function* Stub = Function::Create(F->getFunctionType(), Function::ExternalLinkage,
+                "", module.get());
+        F->replaceAllUsesWith(Stub);
+        F->setName(getBodyName(functionName, version));
+        Stub->setName(functionName.str());
+        bodies.push_back({functionName, version});
+        if (!createStub(functionName)) {
+            return false;
+        }
+    }
+
+    Optimizer optimizer(context.get(), std::move(module), OptLevel, TM.get());
+    optimizer.optimizeCode();
+    auto Handle = TheJIT->addModule(ThreadSafeModule(optimizer.getModule(), std::move(context)));
+    if (!Handle) {
+        logError(Handle.takeError());
+        return false;
+    }
+
+    // nothing changes until every body is there, a rejected input can be
+    // sent again
+    std::vector<JITTargetAddress> addresses;
+    for (auto &body : bodies) {
+        auto Body = TheJIT->lookup(getBodyName(body.first, body.second));
+        if (!Body) {
+            logError(Body.takeError());
+            consumeError(TheJIT->removeModule(*Handle));
+            return false;
+        }
+        addresses.push_back(Body->getAddress());
+    }
+    for (size_t i = 0; i < bodies.size(); i++) {
+        install(bodies[i].first, bodies[i].second, addresses[i]);
+    }
+    for (auto &signature : declared) {
+        Identifier functionName = signature.name;
+        signatures.erase(functionName);
+        signatures.emplace(functionName, std::move(signature));
+    }
+
+    if (!anonName.empty()) {
+        auto Symbol = TheJIT->lookup(anonName);
+        if (!Symbol) {
+            logError(Symbol.takeError());
+            return false;
+        }
+        auto *FP = (void (*)())(intptr_t) Symbol->getAddress();
+        FP();
+        // run once, its module only holds it and can go away
+        consumeError(TheJIT->removeModule(*Handle));
+    }
+    return true;
+}
+
+// Creates the stub of a function defined for the first time, before its
+// body is compiled: the body may call itself. It is pointed to the body by
+// install.
+
+bool Repl::createStub(Identifier name) {
+
+    if (Stubs->findStub(name.str(), true)) {
+        return true;
+    }
+    if (Error Err = Stubs->createStub(name.str(), 0, JITSymbolFlags::Exported)) {
+        logError(std::move(Err));
+        return false;
+    }
+    if (Error Err = TheJIT->define(name.str(), Stubs->findStub(name.str(), true).getAddress())) {
+        logError(std::move(Err));
+        return false;
+    }
+    return true;
+}
+
+// Points the stub of name to the given body. The previous body leaves the
+// symbol table.
+
+void Repl::install(Identifier name, unsigned version, JITTargetAddress Body) {
+
+    ExitOnErr(Stubs->updatePointer(name.str(), Body));
+    unsigned& current = versions[name];
+    if (current != 0) {
+        consumeError(TheJIT->remove(getBodyName(name, current)));
+    }
+    current = version;
+}
+
+void Repl::run(std::istream& in) {
+
+    std::string input;
+    std::string line;
+    int depth = 0;
+    std::cout << "ready> " << std::flush;
+    while (std::getline(in, line)) {
+        std::string code = line.substr(0, line.find('#'));
+        depth += std::count(code.begin(), code.end(), '{') - std::count(code.begin(), code.end(), '}');
+        input += line + "\n";
+
+        StringRef last = StringRef(code).rtrim();
+        if (depth <= 0 && (last.endswith("}") || last.endswith(";"))) {
+            eval(input, "<repl>");
+            input.clear();
+            depth = 0;
+        }
+        std::cout << (input.empty() ? "ready> " : "...    ") << std::flush;
+    }
+
+    if (!StringRef(input).trim().empty()) {
+        eval(input, "<repl>");
+    }
+    std::cout << std::endl;
+}
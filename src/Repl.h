@@ -0,0 +1,70 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef REPL_H
+#define	REPL_H
+
+#include <istream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Target/TargetMachine.h"
+#include "Identifier.h"
+#include "JIT.h"
+#include "LLVMIRGen.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+/// Incremental mode. The JIT lives for the whole session and every input is
+/// compiled into a fresh module added to it. An input is either a group of
+/// definitions and externs, or statements, which are wrapped in an anonymous
+/// function and run right away.
+///
+/// Functions can be redefined (with the same signature): each definition is
+/// compiled as a versioned body and every caller, those in the same input
+/// included, goes through a stub under the function name, which is pointed
+/// to the latest body.
+
+class Repl {
+public:
+    Repl(JITOptions Options, unsigned OptLevel);
+
+    // Compiles and runs one input, false if it was rejected.
+    bool eval(StringRef source, StringRef name);
+    // Reads inputs until the end of the stream, each one ends on a line
+    // closing its last brace or ending with ';'.
+    void run(std::istream& in);
+
+private:
+    std::unique_ptr<KaleidoscopeJIT> TheJIT;
+    std::unique_ptr<TargetMachine> TM;
+    std::unique_ptr<IndirectStubsManager> Stubs;
+    unsigned OptLevel;
+    // functions declared so far, declared again in every new module
+    std::unordered_map<Identifier, FunctionSignature> signatures;
+    // current body version of the functions defined so far
+    std::unordered_map<Identifier, unsigned> versions;
+    unsigned inputs = 0;
+
+    bool scanInput(unsigned FileID, std::vector<Identifier>& defined);
+    bool createStub(Identifier name);
+    void install(Identifier name, unsigned version, JITTargetAddress Body);
+    static std::string getBodyName(Identifier name, unsigned version);
+};
+
+#endif	/* REPL_H */
+
@@ -13,23 +13,46 @@
 //    limitations under the License.
 
 #include <cstdio>
+#include "Runtime.h"
 #ifdef _WIN32
 #define DLLEXPORT __declspec(dllexport)
 #else
 #define DLLEXPORT
 #endif
 
+static thread_local OutputSink* threadSink = nullptr;
+
+OutputSink* setThreadOutputSink(OutputSink* sink) {
+    OutputSink* previous = threadSink;
+    threadSink = sink;
+    return previous;
+}
+
+static void output(const char* data, size_t size) {
+    if (threadSink) {
+        threadSink->write(data, size);
+    } else {
+        fwrite(data, 1, size, stderr);
+    }
+}
+
 /// putchard - putchar that takes a double and returns 0.
 extern "C" DLLEXPORT void putchard(long long X) {
-  fputc((char)X, stderr);
+  char C = (char)X;
+  output(&C, 1);
 }
 
 /// printreal - printf that takes a double prints it as "%f\n".
 extern "C" DLLEXPORT void printreal(double X) {
-  fprintf(stderr, "%f\n", X);
+  // enough for any double in %f
+  char Buffer[320];
+  int Size = snprintf(Buffer, sizeof(Buffer), "%f\n", X);
+  output(Buffer, Size);
 }
 
 /// printinteger - printf that takes an integer prints it as "%lld\n".
 extern "C" DLLEXPORT void printinteger(long long X) {
-  fprintf(stderr, "%lld\n", X);
+  char Buffer[32];
+  int Size = snprintf(Buffer, sizeof(Buffer), "%lld\n", X);
+  output(Buffer, Size);
 }
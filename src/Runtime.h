@@ -0,0 +1,71 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef RUNTIME_H
+#define	RUNTIME_H
+
+#include <cstddef>
+#include <string>
+
+/// Functions of the runtime, called by programs through extern declarations.
+/// They are reentrant: their output goes to the sink of the calling thread,
+/// or to stderr when the thread has none.
+
+extern "C" {
+    void putchard(long long X);
+    void printreal(double X);
+    void printinteger(long long X);
+}
+
+/// Receives the output of the runtime functions.
+
+class OutputSink {
+public:
+    virtual ~OutputSink() {
+    }
+    virtual void write(const char* data, size_t size) = 0;
+};
+
+/// Keeps the output in memory, e.g. to return it with the result of an
+/// execution.
+
+class StringOutputSink : public OutputSink {
+public:
+    void write(const char* data, size_t size) override {
+        output.append(data, size);
+    }
+    std::string output;
+};
+
+// Sets the sink of the calling thread, nullptr goes back to stderr.
+// Returns the previous one.
+OutputSink* setThreadOutputSink(OutputSink* sink);
+
+/// Sends the output of the calling thread to a sink while in scope.
+
+class OutputSinkScope {
+public:
+    explicit OutputSinkScope(OutputSink& sink) : previous(setThreadOutputSink(&sink)) {
+    }
+    ~OutputSinkScope() {
+        setThreadOutputSink(previous);
+    }
+    OutputSinkScope(const OutputSinkScope&) = delete;
+    OutputSinkScope& operator=(const OutputSinkScope&) = delete;
+private:
+    OutputSink* previous;
+};
+
+#endif	/* RUNTIME_H */
+
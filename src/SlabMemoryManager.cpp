@@ -0,0 +1,331 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <algorithm>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Memory.h"
+#include "FunctionLayout.h"
+#include "SlabMemoryManager.h"
+
+static const size_t HugePageSize = 2 << 20;
+
+void SlabStats::print(raw_ostream& OS, const char* Name) const {
+    OS << format("%s: %zu slabs, %.2f MB mapped, %.2f MB used in %zu blocks, "
+            "largest free block %.2f MB, fragmentation %.2f\n", Name, Slabs,
+            MappedBytes / 1048576.0, UsedBytes / 1048576.0, Allocations,
+            LargestFreeBlock / 1048576.0, fragmentation());
+}
+
+#ifdef __linux__
+
+// Maps Size bytes at an address aligned to HugePageSize, nullptr on failure.
+static uint8_t* mapAligned(size_t Size, int Prot, int Flags, int Fd) {
+
+    size_t Reserved = Size + HugePageSize;
+    void* Reservation = mmap(nullptr, Reserved, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (Reservation == MAP_FAILED) {
+        return nullptr;
+    }
+    uintptr_t Begin = (uintptr_t) Reservation;
+    uintptr_t Start = alignTo(Begin, HugePageSize);
+    if (Start > Begin) {
+        munmap(Reservation, Start - Begin);
+    }
+    if (Begin + Reserved > Start + Size) {
+        munmap((void*) (Start + Size), Begin + Reserved - Start - Size);
+    }
+
+    if (mmap((void*) Start, Size, Prot, Flags | MAP_FIXED, Fd, 0) == MAP_FAILED) {
+        munmap((void*) Start, Size);
+        return nullptr;
+    }
+    return (uint8_t*) Start;
+}
+
+// Both views of a code slab map the same memfd pages.
+static bool mapCodeViews(uint8_t*& Write, uint8_t*& Exec, size_t Size, bool HugeTLB) {
+
+    int Fd = memfd_create("jit-code", MFD_CLOEXEC | (HugeTLB ? MFD_HUGETLB : 0));
+    if (Fd < 0) {
+        return false;
+    }
+    Write = Exec = nullptr;
+    if (ftruncate(Fd, Size) == 0) {
+        Write = mapAligned(Size, PROT_READ | PROT_WRITE, MAP_SHARED, Fd);
+        if (Write) {
+            Exec = mapAligned(Size, PROT_READ | PROT_EXEC, MAP_SHARED, Fd);
+            if (!Exec) {
+                munmap(Write, Size);
+            }
+        }
+    }
+    close(Fd);
+    return Exec != nullptr;
+}
+
+std::unique_ptr<SlabPool::Slab> SlabPool::mapSlab(Kind K, size_t Size) {
+
+    auto S = std::make_unique<Slab>();
+    S->Size = Size;
+    // MAP_HUGETLB needs pages reserved by the administrator, transparent
+    // huge pages are the fallback
+    bool HugeTLB = HugePages;
+    if (K != Data) {
+        if (!(HugeTLB && mapCodeViews(S->Write, S->Exec, Size, true))) {
+            HugeTLB = false;
+            if (!mapCodeViews(S->Write, S->Exec, Size, false)) {
+                return nullptr;
+            }
+        }
+    } else {
+        int Flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        S->Write = HugeTLB ? mapAligned(Size, PROT_READ | PROT_WRITE, Flags | MAP_HUGETLB, -1) : nullptr;
+        if (!S->Write) {
+            HugeTLB = false;
+            S->Write = mapAligned(Size, PROT_READ | PROT_WRITE, Flags, -1);
+            if (!S->Write) {
+                return nullptr;
+            }
+        }
+        S->Exec = S->Write;
+    }
+
+    if (HugePages && !HugeTLB) {
+        madvise(S->Write, Size, MADV_HUGEPAGE);
+        if (S->Exec != S->Write) {
+            madvise(S->Exec, Size, MADV_HUGEPAGE);
+        }
+    }
+    S->FreeBlocks[0] = Size;
+    return S;
+}
+
+static void unmapSlab(uint8_t* Write, uint8_t* Exec, size_t Size) {
+    munmap(Write, Size);
+    if (Exec != Write) {
+        munmap(Exec, Size);
+    }
+}
+
+Expected<std::unique_ptr<SlabPool>> SlabPool::Create(size_t SlabSize, bool HugePages) {
+
+    std::unique_ptr<SlabPool> Pool(new SlabPool(alignTo(SlabSize, HugePageSize), HugePages));
+    // fails early where memfd is not available
+    uint8_t* Exec;
+    uint8_t* Addr = Pool->allocate(Code, 1, 1, Exec);
+    if (!Addr) {
+        return make_error<StringError>("cannot map JIT code memory", inconvertibleErrorCode());
+    }
+    Pool->free(Code, Addr, 1);
+    return std::move(Pool);
+}
+
+#else
+
+std::unique_ptr<SlabPool::Slab> SlabPool::mapSlab(Kind K, size_t Size) {
+    return nullptr;
+}
+
+static void unmapSlab(uint8_t* Write, uint8_t* Exec, size_t Size) {
+}
+
+Expected<std::unique_ptr<SlabPool>> SlabPool::Create(size_t SlabSize, bool HugePages) {
+    return make_error<StringError>("pooled JIT memory needs Linux", inconvertibleErrorCode());
+}
+
+#endif
+
+SlabPool::~SlabPool() {
+    for (auto &Kind : Slabs) {
+        for (auto &S : Kind) {
+            unmapSlab(S->Write, S->Exec, S->Size);
+        }
+    }
+}
+
+uint8_t* SlabPool::allocateFrom(Slab& S, size_t Size, unsigned Alignment) {
+
+    for (auto I = S.FreeBlocks.begin(); I != S.FreeBlocks.end(); ++I) {
+        size_t Offset = I->first;
+        size_t End = Offset + I->second;
+        size_t Start = alignTo((uintptr_t) S.Write + Offset, Alignment) - (uintptr_t) S.Write;
+        if (Start + Size > End) {
+            continue;
+        }
+        S.FreeBlocks.erase(I);
+        if (Start > Offset) {
+            S.FreeBlocks[Offset] = Start - Offset;
+        }
+        if (Start + Size < End) {
+            S.FreeBlocks[Start + Size] = End - Start - Size;
+        }
+        return S.Write + Start;
+    }
+    return nullptr;
+}
+
+uint8_t* SlabPool::allocate(Kind K, size_t Size, unsigned Alignment, uint8_t*& Exec) {
+
+    Size = std::max<size_t>(Size, 1);
+    Alignment = std::max(Alignment, 1u);
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    for (auto &S : Slabs[K]) {
+        if (uint8_t* Addr = allocateFrom(*S, Size, Alignment)) {
+            Allocations[K]++;
+            Exec = S->Exec + (Addr - S->Write);
+            return Addr;
+        }
+    }
+
+    // bigger than a slab: it gets one of its own
+    auto S = mapSlab(K, std::max(SlabSize, alignTo(Size + Alignment, HugePageSize)));
+    if (!S) {
+        return nullptr;
+    }
+    uint8_t* Addr = allocateFrom(*S, Size, Alignment);
+    Allocations[K]++;
+    Exec = S->Exec + (Addr - S->Write);
+    Slabs[K].push_back(std::move(S));
+    return Addr;
+}
+
+void SlabPool::free(Kind K, uint8_t* Addr, size_t Size) {
+
+    Size = std::max<size_t>(Size, 1);
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    auto &KindSlabs = Slabs[K];
+    auto It = std::find_if(KindSlabs.begin(), KindSlabs.end(), [&](const std::unique_ptr<Slab>& S) {
+        return Addr >= S->Write && Addr < S->Write + S->Size;
+    });
+    if (It == KindSlabs.end()) {
+        return;
+    }
+    Slab& S = **It;
+    Allocations[K]--;
+
+    size_t Offset = Addr - S.Write;
+    auto Next = S.FreeBlocks.lower_bound(Offset);
+    if (Next != S.FreeBlocks.end() && Offset + Size == Next->first) {
+        Size += Next->second;
+        Next = S.FreeBlocks.erase(Next);
+    }
+    if (Next != S.FreeBlocks.begin() && std::prev(Next)->first + std::prev(Next)->second == Offset) {
+        std::prev(Next)->second += Size;
+    } else {
+        S.FreeBlocks[Offset] = Size;
+    }
+
+    // empty slabs go back to the system, but one is kept for the next object
+    if (KindSlabs.size() > 1 && S.FreeBlocks.size() == 1 && S.FreeBlocks.begin()->second == S.Size) {
+        unmapSlab(S.Write, S.Exec, S.Size);
+        KindSlabs.erase(It);
+    }
+}
+
+SlabStats SlabPool::getStats(Kind K) {
+
+    std::lock_guard<std::mutex> Guard(Lock);
+    SlabStats Stats;
+    Stats.Slabs = Slabs[K].size();
+    Stats.Allocations = Allocations[K];
+    for (auto &S : Slabs[K]) {
+        Stats.MappedBytes += S->Size;
+        for (auto &Free : S->FreeBlocks) {
+            Stats.FreeBytes += Free.second;
+            Stats.LargestFreeBlock = std::max(Stats.LargestFreeBlock, Free.second);
+        }
+    }
+    Stats.UsedBytes = Stats.MappedBytes - Stats.FreeBytes;
+    return Stats;
+}
+
+void SlabPool::printStats(raw_ostream& OS) {
+    getStats(Code).print(OS, "JIT code memory");
+    SlabStats Cold = getStats(ColdCode);
+    if (Cold.Slabs) {
+        Cold.print(OS, "JIT cold code memory");
+    }
+    getStats(Data).print(OS, "JIT data memory");
+}
+
+SlabMemoryManager::~SlabMemoryManager() {
+    deregisterEHFrames();
+    for (auto &B : Blocks) {
+        Pool.free(B.K, B.Write, B.Size);
+    }
+}
+
+uint8_t* SlabMemoryManager::allocate(SlabPool::Kind K, uintptr_t Size, unsigned Alignment) {
+    uint8_t* Exec;
+    uint8_t* Addr = Pool.allocate(K, Size, Alignment, Exec);
+    // RuntimeDyld reports a failed allocation
+    if (Addr) {
+        Blocks.push_back({K, Addr, Exec, Size});
+    }
+    return Addr;
+}
+
+uint8_t* SlabMemoryManager::allocateCodeSection(uintptr_t Size, unsigned Alignment,
+        unsigned SectionID, StringRef SectionName) {
+    bool Cold = SectionName.startswith(FunctionLayout::ColdSection);
+    return allocate(Cold ? SlabPool::ColdCode : SlabPool::Code, Size, Alignment);
+}
+
+// Read-only data stays in the data slabs: it is only read-only by convention,
+// but it does not need to move to the execute view.
+
+uint8_t* SlabMemoryManager::allocateDataSection(uintptr_t Size, unsigned Alignment,
+        unsigned SectionID, StringRef SectionName, bool IsReadOnly) {
+    return allocate(SlabPool::Data, Size, Alignment);
+}
+
+// Called before relocations are resolved: code is relocated for the address
+// it runs at, while RuntimeDyld keeps writing to the writable view.
+
+void SlabMemoryManager::notifyObjectLoaded(RuntimeDyld& RTDyld, const object::ObjectFile& Obj) {
+    for (auto &B : Blocks) {
+        if (B.K != SlabPool::Data) {
+            RTDyld.mapSectionAddress(B.Write, (uint64_t) (uintptr_t) B.Exec);
+        }
+    }
+}
+
+void SlabMemoryManager::registerEHFrames(uint8_t* Addr, uint64_t LoadAddr, size_t Size) {
+    RTDyldMemoryManager::registerEHFramesInProcess(Addr, Size);
+    EHFrames.push_back({Addr, Size});
+}
+
+void SlabMemoryManager::deregisterEHFrames() {
+    for (auto &Frame : EHFrames) {
+        RTDyldMemoryManager::deregisterEHFramesInProcess(Frame.first, Frame.second);
+    }
+    EHFrames.clear();
+}
+
+bool SlabMemoryManager::finalizeMemory(std::string* ErrMsg) {
+    for (auto &B : Blocks) {
+        if (B.K != SlabPool::Data) {
+            sys::Memory::InvalidateInstructionCache(B.Exec, B.Size);
+        }
+    }
+    return false;
+}
+
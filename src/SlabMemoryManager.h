@@ -0,0 +1,143 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef SLABMEMORYMANAGER_H
+#define	SLABMEMORYMANAGER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "llvm/ExecutionEngine/RuntimeDyld.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+/// Occupation of a SlabPool.
+struct SlabStats {
+    size_t Slabs = 0;
+    size_t MappedBytes = 0;
+    // in live allocations, alignment padding included
+    size_t UsedBytes = 0;
+    size_t FreeBytes = 0;
+    size_t LargestFreeBlock = 0;
+    size_t Allocations = 0;
+
+    // 0 when the free space is in one block, near 1 when it is scattered
+    double fragmentation() const {
+        return FreeBytes ? 1.0 - (double) LargestFreeBlock / FreeBytes : 0.0;
+    }
+    void print(raw_ostream& OS, const char* Name) const;
+};
+
+/// Large regions the code and data of every object are carved from, so small
+/// objects share pages instead of getting their own. Cold code (see
+/// FunctionLayout) has slabs of its own, away from the hot code. Code slabs are memfd
+/// regions mapped twice: code is written and relocated through a read-write
+/// view and runs from a read-execute view, so no page is ever writable and
+/// executable and objects on the same page do not need to change its
+/// protection. Data slabs are plain read-write memory.
+///
+/// Allocation is first fit over a free list per slab, freed blocks are
+/// coalesced with their neighbours. Slabs are 2MB aligned; with HugePages
+/// they are backed by huge pages (MAP_HUGETLB) when the system has some
+/// reserved, otherwise transparent huge pages are requested. Linux only.
+///
+/// A pool must not be shared across fork(): the code slabs are MAP_SHARED,
+/// so parent and child would carve the same pages out of their own copies
+/// of the free lists and overwrite each other's code.
+
+class SlabPool {
+public:
+    enum Kind {
+        Code = 0,
+        ColdCode,
+        Data
+    };
+
+    static Expected<std::unique_ptr<SlabPool>> Create(size_t SlabSize, bool HugePages);
+    ~SlabPool();
+
+    // Returns the address to write to; Exec gets the one the memory is used
+    // from, the same for data. nullptr if no memory could be mapped.
+    uint8_t* allocate(Kind K, size_t Size, unsigned Alignment, uint8_t*& Exec);
+    void free(Kind K, uint8_t* Addr, size_t Size);
+
+    SlabStats getStats(Kind K);
+    void printStats(raw_ostream& OS);
+
+private:
+
+    struct Slab {
+        uint8_t* Write;
+        uint8_t* Exec;
+        size_t Size;
+        // offset -> size of the free blocks
+        std::map<size_t, size_t> FreeBlocks;
+    };
+
+    size_t SlabSize;
+    bool HugePages;
+    std::mutex Lock;
+    std::vector<std::unique_ptr<Slab>> Slabs[3];
+    size_t Allocations[3] = {0, 0, 0};
+
+    SlabPool(size_t SlabSize, bool HugePages) : SlabSize(SlabSize), HugePages(HugePages) {
+    }
+
+    std::unique_ptr<Slab> mapSlab(Kind K, size_t Size);
+    static uint8_t* allocateFrom(Slab& S, size_t Size, unsigned Alignment);
+};
+
+/// Memory manager of one object, on top of a shared SlabPool. Code sections
+/// are relocated for their execute view, see notifyObjectLoaded. Everything
+/// goes back to the pool when the manager is destroyed.
+
+class SlabMemoryManager : public RuntimeDyld::MemoryManager {
+public:
+
+    explicit SlabMemoryManager(SlabPool& Pool) : Pool(Pool) {
+    }
+    ~SlabMemoryManager() override;
+
+    uint8_t* allocateCodeSection(uintptr_t Size, unsigned Alignment, unsigned SectionID,
+            StringRef SectionName) override;
+    uint8_t* allocateDataSection(uintptr_t Size, unsigned Alignment, unsigned SectionID,
+            StringRef SectionName, bool IsReadOnly) override;
+    void notifyObjectLoaded(RuntimeDyld& RTDyld, const object::ObjectFile& Obj) override;
+    void registerEHFrames(uint8_t* Addr, uint64_t LoadAddr, size_t Size) override;
+    void deregisterEHFrames() override;
+    bool finalizeMemory(std::string* ErrMsg = nullptr) override;
+
+private:
+
+    struct Block {
+        SlabPool::Kind K;
+        uint8_t* Write;
+        uint8_t* Exec;
+        size_t Size;
+    };
+
+    SlabPool& Pool;
+    std::vector<Block> Blocks;
+    std::vector<std::pair<uint8_t*, size_t>> EHFrames;
+
+    uint8_t* allocate(SlabPool::Kind K, uintptr_t Size, unsigned Alignment);
+};
+
+#endif	/* SLABMEMORYMANAGER_H */
+
@@ -0,0 +1,89 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <algorithm>
+#include "SourceManager.h"
+
+SourceManager& SourceManager::get() {
+    static SourceManager instance;
+    return instance;
+}
+
+unsigned SourceManager::addBuffer(std::unique_ptr<llvm::MemoryBuffer> buffer,
+        const std::string& name) {
+    std::lock_guard<std::mutex> guard(lock);
+    files.push_back({std::move(buffer), name, {}});
+    return files.size() - 1;
+}
+
+void SourceManager::removeBuffer(unsigned FileID) {
+    std::lock_guard<std::mutex> guard(lock);
+    // the slot stays, so the other files keep their place
+    SourceFile& file = files[FileID];
+    file.buffer.reset();
+    std::string().swap(file.name);
+    std::vector<uint32_t>().swap(file.lineStarts);
+}
+
+SourceManager::SourceFile& SourceManager::getFile(unsigned FileID) {
+    std::lock_guard<std::mutex> guard(lock);
+    return files[FileID];
+}
+
+llvm::StringRef SourceManager::getBuffer(unsigned FileID) {
+    return getFile(FileID).buffer->getBuffer();
+}
+
+const std::string& SourceManager::getFileName(unsigned FileID) {
+    return getFile(FileID).name;
+}
+
+// index of the line containing offset, starting at 0
+unsigned SourceManager::findLine(SourceFile& file, uint32_t offset) {
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (file.lineStarts.empty()) {
+        llvm::StringRef text = file.buffer->getBuffer();
+        file.lineStarts.push_back(0);
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '\n') {
+                file.lineStarts.push_back(i + 1);
+            }
+        }
+    }
+    auto it = std::upper_bound(file.lineStarts.begin(), file.lineStarts.end(), offset);
+    return it - file.lineStarts.begin() - 1;
+}
+
+void SourceManager::getLineAndColumn(unsigned FileID, uint32_t offset, unsigned& line,
+        unsigned& column) {
+    SourceFile& file = getFile(FileID);
+    unsigned idx = findLine(file, offset);
+    line = idx + 1;
+    column = offset - file.lineStarts[idx] + 1;
+}
+
+std::string SourceManager::describe(unsigned FileID, uint32_t offset) {
+
+    SourceFile& file = getFile(FileID);
+    unsigned idx = findLine(file, offset);
+    uint32_t start = file.lineStarts[idx];
+
+    llvm::StringRef text = file.buffer->getBuffer();
+    llvm::StringRef lineText = text.substr(start).take_until([](char c) {
+        return c == '\n' || c == '\r'; });
+
+    return file.name + ": line " + std::to_string(idx + 1) + " col " +
+            std::to_string(offset - start + 1) + ": " + lineText.str();
+}
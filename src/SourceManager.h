@@ -0,0 +1,91 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef SOURCEMANAGER_H
+#define	SOURCEMANAGER_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+/// Owns the source buffers of the process: they stay mapped until removed,
+/// so the lexer and the AST can point into them. Sources compiled and then
+/// dropped, as in the embedding API and the REPL, are removed once compiled,
+/// ids are not reused. Locations are
+/// kept as (file id, byte offset) and only turned into line, column and line
+/// text when a diagnostic is printed. Thread safe.
+
+class SourceManager {
+public:
+    static SourceManager& get();
+
+    unsigned addBuffer(std::unique_ptr<llvm::MemoryBuffer> buffer, const std::string& name);
+    // releases the buffer, nothing may refer to it anymore
+    void removeBuffer(unsigned FileID);
+    llvm::StringRef getBuffer(unsigned FileID);
+    const std::string& getFileName(unsigned FileID);
+
+    // both start at 1
+    void getLineAndColumn(unsigned FileID, uint32_t offset, unsigned& line, unsigned& column);
+    // "file: line L col C: text of the line"
+    std::string describe(unsigned FileID, uint32_t offset);
+
+private:
+
+    struct SourceFile {
+        std::unique_ptr<llvm::MemoryBuffer> buffer;
+        std::string name;
+        // offsets where lines start, computed by the first diagnostic
+        std::vector<uint32_t> lineStarts;
+    };
+
+    std::mutex lock;
+    // deque: files do not move when new ones are added
+    std::deque<SourceFile> files;
+
+    SourceFile& getFile(unsigned FileID);
+    unsigned findLine(SourceFile& file, uint32_t offset);
+};
+
+/// Removes a buffer from the SourceManager when going out of scope.
+
+class ScopedSourceBuffer {
+public:
+    explicit ScopedSourceBuffer(unsigned FileID) : FileID(FileID) {
+    }
+
+    ~ScopedSourceBuffer() {
+        SourceManager::get().removeBuffer(FileID);
+    }
+
+    // removes the current buffer and takes over FileID
+    void reset(unsigned FileID) {
+        SourceManager::get().removeBuffer(this->FileID);
+        this->FileID = FileID;
+    }
+
+    ScopedSourceBuffer(const ScopedSourceBuffer&) = delete;
+    ScopedSourceBuffer& operator=(const ScopedSourceBuffer&) = delete;
+
+private:
+    unsigned FileID;
+};
+
+#endif	/* SOURCEMANAGER_H */
+
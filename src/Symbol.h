@@ -0,0 +1,56 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef SYMBOL_H
+#define	SYMBOL_H
+
+#include <string>
+#include "Identifier.h"
+
+enum StorageType {
+    LOCAL = 0,
+    GLOBAL
+};
+
+template<typename SSAType>
+class Symbol {
+    Identifier name;
+    SSAType memRef;
+    StorageType storageType;
+    int scope;
+public:
+
+    Symbol(Identifier name, SSAType memRef, StorageType storageType, int scope) :
+    name(name), memRef(memRef), storageType(storageType), scope(scope) {
+    }
+
+    Identifier getName() {
+        return name;
+    }
+
+    SSAType getMemRef() {
+        return memRef;
+    }
+
+    int getScopeLevel() {
+        return scope;
+    }
+
+    StorageType getStorageType() {
+        return storageType;
+    };
+};
+
+#endif	/* SYMBOL_H */
+
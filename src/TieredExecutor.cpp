@@ -0,0 +1,150 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <iostream>
+#include <vector>
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/TargetSelect.h"
+#include "TieredExecutor.h"
+
+static void logError(Error Err) {
+    logAllUnhandledErrors(std::move(Err), errs(), "JIT tier not available, staying in the interpreter: ");
+}
+
+static const char* AdapterPrefix = "__tier_";
+
+TieredExecutor::TieredExecutor(std::unique_ptr<BytecodeModule> TheModule,
+        ModuleBuilder BuildModule, uint64_t threshold, JITOptions Options) :
+BuildModule(std::move(BuildModule)), Options(std::move(Options)) {
+
+    TheInterpreter = std::make_unique<Interpreter>(std::move(TheModule), threshold,
+            [this]() {
+                promote(); });
+}
+
+TieredExecutor::~TieredExecutor() {
+    // the JIT cannot go away under the compiler thread
+    if (CompilerThread.joinable()) {
+        CompilerThread.join();
+    }
+}
+
+void TieredExecutor::execute() {
+
+    int idx = TheInterpreter->getModule().lookup("main");
+    if (idx < 0 || !TheInterpreter->getModule().functions[idx].defined) {
+        std::cout << "Main function not found" << std::endl;
+        return;
+    }
+
+    TheInterpreter->call(idx, nullptr);
+}
+
+// Start the JIT tier, only once: the whole module is compiled in one go.
+
+void TieredExecutor::promote() {
+    std::call_once(promotion, [this]() {
+        // taken here, the counters keep changing on this thread
+        Profile = TheInterpreter->getProfile();
+        CompilerThread = std::thread([this]() {
+            compile(); });
+    });
+}
+
+// Generate "void __tier_f(i64* args, i64* ret)" for f, so the interpreter
+// can call any promoted function through a single signature.
+
+static void emitAdapter(Module& M, Function& F) {
+
+    LLVMContext& C = M.getContext();
+    Type* SlotPtrTy = Type::getInt64PtrTy(C);
+    FunctionType* FT = FunctionType::get(Type::getVoidTy(C), {SlotPtrTy, SlotPtrTy}, false);
+    Function* Adapter = Function::Create(FT, Function::ExternalLinkage,
+            AdapterPrefix + F.getName(), &M);
+
+    IRBuilder<> Builder(BasicBlock::Create(C, "entry", Adapter));
+    Value* Args = Adapter->getArg(0);
+    Value* Ret = Adapter->getArg(1);
+
+    std::vector<Value*> CallArgs;
+    for (auto &Arg : F.args()) {
+        Value* Slot = Builder.CreateLoad(Builder.CreateConstInBoundsGEP1_64(Args, Arg.getArgNo()));
+        CallArgs.push_back(Builder.CreateBitCast(Slot, Arg.getType()));
+    }
+
+    Value* Result = Builder.CreateCall(&F, CallArgs);
+    if (!F.getReturnType()->isVoidTy()) {
+        Builder.CreateStore(Builder.CreateBitCast(Result, Type::getInt64Ty(C)), Ret);
+    }
+    Builder.CreateRetVoid();
+}
+
+// Body of the compiler thread: the JIT tier is built from scratch here, so
+// programs that never get hot do not pay for LLVM at all.
+
+void TieredExecutor::compile() {
+
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+    InitializeNativeTargetAsmParser();
+
+    TheContext = std::make_unique<LLVMContext>();
+    std::unique_ptr<Module> TheModule = BuildModule(TheContext.get(), Profile);
+    if (!TheModule) {
+        errs() << "JIT tier not available, staying in the interpreter\n";
+        return;
+    }
+
+    std::vector<Function*> Defined;
+    for (auto &F : *TheModule) {
+        if (!F.isDeclaration()) {
+            Defined.push_back(&F);
+        }
+    }
+    for (auto *F : Defined) {
+        emitAdapter(*TheModule, *F);
+    }
+
+    // on any error the program keeps running in the interpreter
+    auto JIT = KaleidoscopeJIT::Create(Options);
+    if (!JIT) {
+        logError(JIT.takeError());
+        return;
+    }
+    TheJIT = std::move(*JIT);
+    TheModule->setDataLayout(TheJIT->getDataLayout());
+    auto Handle = TheJIT->addModule(std::move(TheModule));
+    if (!Handle) {
+        logError(Handle.takeError());
+        return;
+    }
+
+    // every function is found before any is installed
+    const BytecodeModule& BM = TheInterpreter->getModule();
+    std::vector<std::pair<unsigned, NativeEntry>> entries;
+    for (unsigned idx = 0; idx < BM.functions.size(); idx++) {
+        if (!BM.functions[idx].defined) {
+            continue;
+        }
+        auto Symbol = TheJIT->lookup(AdapterPrefix + BM.functions[idx].name);
+        if (!Symbol) {
+            logError(Symbol.takeError());
+            return;
+        }
+        entries.push_back({idx, (NativeEntry) (intptr_t) Symbol->getAddress()});
+    }
+    for (auto &entry : entries) {
+        TheInterpreter->installNative(entry.first, entry.second);
+    }
+}
@@ -0,0 +1,65 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef TIEREDEXECUTOR_H
+#define	TIEREDEXECUTOR_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "Bytecode.h"
+#include "FunctionLayout.h"
+#include "Interpreter.h"
+#include "JIT.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+/// Runs a program in the bytecode interpreter and, once some function gets
+/// hot, builds the optimized LLVM module in a background thread. Hot
+/// functions are then called through the JIT tier. There is no on-stack
+/// replacement: a running activation (e.g. a hot loop in main) stays in the
+/// interpreter, only new calls are promoted.
+
+class TieredExecutor {
+public:
+    // generates the optimized module for the same program in the given
+    // context, the profile is what the interpreter counted until promotion
+    using ModuleBuilder = std::function<std::unique_ptr<Module>(LLVMContext*,
+            const FunctionCounts&)>;
+
+    TieredExecutor(std::unique_ptr<BytecodeModule> TheModule, ModuleBuilder BuildModule,
+            uint64_t threshold, JITOptions Options = JITOptions());
+    ~TieredExecutor();
+
+    void execute();
+private:
+    std::unique_ptr<Interpreter> TheInterpreter;
+    ModuleBuilder BuildModule;
+    JITOptions Options;
+    std::unique_ptr<LLVMContext> TheContext;
+    std::unique_ptr<KaleidoscopeJIT> TheJIT;
+    std::thread CompilerThread;
+    std::once_flag promotion;
+    FunctionCounts Profile;
+
+    void promote();
+    void compile();
+};
+
+#endif	/* TIEREDEXECUTOR_H */
+
@@ -0,0 +1,124 @@
+//    Copyright 2020 Andreu Carminati
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef TOKENBUFFER_H
+#define	TOKENBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Identifier.h"
+#include "LangDefs.h"
+
+/// The tokens of a whole file, lexed in a single pass (see Lexer::tokenize)
+/// and kept as parallel arrays, so walking the kinds only touches the kinds.
+/// Read only once built, it can be shared by parsers in several threads.
+
+class TokenBuffer {
+public:
+
+    // value of words and literals; integer literals are kept as doubles,
+    // like the lexer does
+    union Payload {
+        const void* identifier;
+        double number;
+    };
+
+    TokenBuffer(unsigned FileID) : FileID(FileID) {
+    }
+
+    void reserve(size_t count) {
+        kinds.reserve(count);
+        operations.reserve(count);
+        offsets.reserve(count);
+        payloads.reserve(count);
+    }
+
+    // punctuation and tok_eof
+    void add(int kind, uint32_t offset) {
+        Payload payload;
+        payload.identifier = nullptr;
+        push(kind, offset, 0, payload);
+    }
+
+    // identifiers, keywords and type names
+    void addWord(int kind, uint32_t offset, Identifier word) {
+        Payload payload;
+        payload.identifier = word.getOpaqueValue();
+        push(kind, offset, 0, payload);
+    }
+
+    void addNumber(int kind, uint32_t offset, double number) {
+        Payload payload;
+        payload.number = number;
+        push(kind, offset, 0, payload);
+    }
+
+    // tok_operator
+    void addOperator(int kind, uint32_t offset, Operation operation, OperationType opType) {
+        Payload payload;
+        payload.identifier = nullptr;
+        push(kind, offset, operation | (opType << 7), payload);
+    }
+
+    size_t size() const {
+        return kinds.size();
+    }
+
+    unsigned getFileID() const {
+        return FileID;
+    }
+
+    int getKind(size_t idx) const {
+        return kinds[idx];
+    }
+
+    uint32_t getOffset(size_t idx) const {
+        return offsets[idx];
+    }
+
+    Operation getOperation(size_t idx) const {
+        return Operation(operations[idx] & 0x7f);
+    }
+
+    OperationType getOpType(size_t idx) const {
+        return OperationType(operations[idx] >> 7);
+    }
+
+    Identifier getIdentifier(size_t idx) const {
+        return Identifier::getFromOpaqueValue(payloads[idx].identifier);
+    }
+
+    double getNumber(size_t idx) const {
+        return payloads[idx].number;
+    }
+
+private:
+    unsigned FileID;
+    std::vector<int16_t> kinds;
+    // Operation in the low 7 bits, OperationType in the high one
+    std::vector<uint8_t> operations;
+    std::vector<uint32_t> offsets;
+    std::vector<Payload> payloads;
+
+    void push(int kind, uint32_t offset, uint8_t operation, Payload payload) {
+        kinds.push_back(kind);
+        operations.push_back(operation);
+        offsets.push_back(offset);
+        payloads.push_back(payload);
+    }
+};
+
+#endif	/* TOKENBUFFER_H */
+